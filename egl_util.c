@@ -25,6 +25,7 @@
 #endif
 
 #include <stdio.h>
+#include <string.h>
 #include "egl_util.h"
 #include <libdrm/drm_fourcc.h>
 #include <assert.h>
@@ -67,6 +68,26 @@ EGLImageKHR createEglImageFromDmaBuf(EGLDisplay eglDisplay, EGLContext eglContex
     return eglImage;
 }
 
+EGLDisplay getOffscreenEglDisplay()
+{
+    EGLDisplay eglDisplay = EGL_NO_DISPLAY;
+    // client extensions, queried without display
+    const char *extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = NULL;
+
+    if (extensions && strstr(extensions, "EGL_MESA_platform_surfaceless"))
+        getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay)
+        eglDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    // EGL_PLATFORM=surfaceless selects it for the default display as well
+    if (eglDisplay == EGL_NO_DISPLAY) {
+        fprintf(stderr, "EGL_MESA_platform_surfaceless isn't supported, try the default display\n");
+        eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+
+    return eglDisplay;
+}
+
 EGLImageKHR createEglImageFromHandle(EGLDisplay eglDisplay, EGLContext eglContext, int isDmabuf, uint32_t handle, int width, int height, int pitch)
 {
     EGLImageKHR eglImage = EGL_NO_IMAGE_KHR;
@@ -33,6 +33,8 @@ extern "C" {
 EGLImageKHR createEglImageFromDrmBuffer(EGLDisplay eglDisplay, EGLContext eglContext, uint32_t drmName, int width, int height, int pitch);
 EGLImageKHR createEglImageFromDmaBuf(EGLDisplay eglDisplay, EGLContext eglContext, uint32_t dmaBuf, int width, int height, int pitch);
 EGLImageKHR createEglImageFromHandle(EGLDisplay eglDisplay, EGLContext eglContext, int isDmabuf, uint32_t dmaBuf, int width, int height, int pitch);
+// display without window system (EGL_MESA_platform_surfaceless), for rendering to pbuffers on headless machines
+EGLDisplay getOffscreenEglDisplay();
 
 #ifdef __cplusplus
 }
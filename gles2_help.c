@@ -24,8 +24,10 @@
 #endif
 
 #include "gles2_help.h"
+#include "egl_util.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 
 #define ERROR printf
@@ -64,6 +66,31 @@ static const char *fragShaderText_rgba_ext =
   "   gl_FragColor.a = 1.0;\n"
   "}\n";
 
+// yuv planes are uploaded as luminance (Y, U, V) or luminance_alpha (interleaved UV) textures
+static const char *fragShaderText_i420 =
+  "precision mediump float;\n"
+  "uniform sampler2D tex0;\n"
+  "uniform sampler2D tex1;\n"
+  "uniform sampler2D tex2;\n"
+  "uniform mat3 colorMatrix;\n"
+  "uniform vec3 colorOffset;\n"
+  "varying vec2 v_texcoord;\n"
+  "void main() {\n"
+  "   vec3 yuv = vec3(texture2D(tex0, v_texcoord).r, texture2D(tex1, v_texcoord).r, texture2D(tex2, v_texcoord).r);\n"
+  "   gl_FragColor = vec4(colorMatrix * (yuv - colorOffset), 1.0);\n"
+  "}\n";
+static const char *fragShaderText_nv12 =
+  "precision mediump float;\n"
+  "uniform sampler2D tex0;\n"
+  "uniform sampler2D tex1;\n"
+  "uniform mat3 colorMatrix;\n"
+  "uniform vec3 colorOffset;\n"
+  "varying vec2 v_texcoord;\n"
+  "void main() {\n"
+  "   vec3 yuv = vec3(texture2D(tex0, v_texcoord).r, texture2D(tex1, v_texcoord).ra);\n"
+  "   gl_FragColor = vec4(colorMatrix * (yuv - colorOffset), 1.0);\n"
+  "}\n";
+
 static const char *vertexShaderText_rgba =
   "attribute vec4 pos;\n"
   "attribute vec2 texcoord;\n"
@@ -99,7 +126,7 @@ createShaders(const char *vertexShaderText, const char *fragShaderText, int texC
     char log[BUFFER_SIZE];
     GLsizei logSize;
 
-    glProgram = calloc(1, sizeof(glProgram));
+    glProgram = calloc(1, sizeof(GLProgram));
     if (!glProgram)
         return NULL;
 
@@ -141,8 +168,10 @@ createShaders(const char *vertexShaderText, const char *fragShaderText, int texC
     glProgram->attrPosition = glGetAttribLocation(glProgram->program, "pos");
     glProgram->attrTexCoord = glGetAttribLocation(glProgram->program, "texcoord");
     glProgram->uniformTex[0] = glGetUniformLocation(glProgram->program, "tex0");
-    // glProgram->uniformTex[1] = glGetUniformLocation(glProgram->program, "tex1");
-    // glProgram->uniformTex[2] = glGetUniformLocation(glProgram->program, "tex2");
+    glProgram->uniformTex[1] = glGetUniformLocation(glProgram->program, "tex1");
+    glProgram->uniformTex[2] = glGetUniformLocation(glProgram->program, "tex2");
+    glProgram->uniformColorMatrix = glGetUniformLocation(glProgram->program, "colorMatrix");
+    glProgram->uniformColorOffset = glGetUniformLocation(glProgram->program, "colorOffset");
 
     INFO("Attrib pos at %d\n", glProgram->attrPosition);
     INFO("Attrib texcoord at %d\n", glProgram->attrTexCoord);
@@ -165,6 +194,185 @@ releaseShader(GLProgram *program)
     free(program);
 }
 
+void
+setYuvColorSpace(EGLContextType *context, int isBT709, int isFullRange)
+{
+    // Kr/Kb of the luma equation Y = Kr*R + (1-Kr-Kb)*G + Kb*B
+    float kr = isBT709 ? 0.2126f : 0.299f;
+    float kb = isBT709 ? 0.0722f : 0.114f;
+    float kg = 1.0f - kr - kb;
+    float ys = isFullRange ? 1.0f : 255.0f / 219.0f;
+    float cs = isFullRange ? 1.0f : 255.0f / 224.0f;
+    // column major, rgb = matrix * (yuv - offset)
+    const GLfloat matrix[9] = {
+        ys,                             ys,                                     ys,
+        0.0f,                           -cs * 2.0f * (1.0f - kb) * kb / kg,     cs * 2.0f * (1.0f - kb),
+        cs * 2.0f * (1.0f - kr),        -cs * 2.0f * (1.0f - kr) * kr / kg,     0.0f
+    };
+    const GLfloat offset[3] = { isFullRange ? 0.0f : 16.0f / 255.0f, 128.0f / 255.0f, 128.0f / 255.0f };
+
+    if (!context || !context->glProgram || context->glProgram->uniformColorMatrix < 0)
+        return;
+
+    glUseProgram(context->glProgram->program);
+    glUniformMatrix3fv(context->glProgram->uniformColorMatrix, 1, GL_FALSE, matrix);
+    glUniform3fv(context->glProgram->uniformColorOffset, 1, offset);
+    // fit mode keeps the program bound
+    if (!context->draw.options.fit)
+        glUseProgram(0);
+}
+
+// eglQuerySurface isn't free, poll for window resize every that many frames
+#define SURFACE_CHECK_INTERVAL 30
+
+// scale the quad down on one axis so the video keeps its aspect ratio, only called on size change
+static void
+updateFitQuad(EGLContextType *context)
+{
+    DrawState *draw = &context->draw;
+    GLfloat sx = 1.0f, sy = 1.0f;
+
+    if (draw->videoWidth > 0 && draw->videoHeight > 0 && draw->surfaceWidth > 0 && draw->surfaceHeight > 0) {
+        int64_t videoSpan = (int64_t)draw->videoWidth * draw->surfaceHeight;
+        int64_t surfaceSpan = (int64_t)draw->surfaceWidth * draw->videoHeight;
+        if (videoSpan > surfaceSpan)
+            sy = (GLfloat)surfaceSpan / videoSpan;
+        else if (videoSpan < surfaceSpan)
+            sx = (GLfloat)videoSpan / surfaceSpan;
+    }
+    // x, y, s, t of a triangle strip
+    const GLfloat quad[4][4] = {
+        { -sx, -sy, 0.0f, 1.0f },
+        {  sx, -sy, 1.0f, 1.0f },
+        { -sx,  sy, 0.0f, 0.0f },
+        {  sx,  sy, 1.0f, 0.0f }
+    };
+
+    draw->letterbox = sx < 1.0f || sy < 1.0f;
+    glBindBuffer(GL_ARRAY_BUFFER, draw->vbo);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(quad), quad);
+}
+
+static void
+updateSurfaceSize(EGLContextType *context)
+{
+    DrawState *draw = &context->draw;
+    EGLint width = 0, height = 0;
+
+    eglQuerySurface(context->eglContext.display, context->eglContext.surface, EGL_WIDTH, &width);
+    eglQuerySurface(context->eglContext.display, context->eglContext.surface, EGL_HEIGHT, &height);
+    if (width <= 0 || height <= 0 || (width == draw->surfaceWidth && height == draw->surfaceHeight))
+        return;
+
+    DEBUG("draw surface %dx%d\n", width, height);
+    draw->surfaceWidth = width;
+    draw->surfaceHeight = height;
+    glViewport(0, 0, width, height);
+    updateFitQuad(context);
+}
+
+void
+setDrawVideoSize(EGLContextType *context, int width, int height)
+{
+    if (!context || (context->draw.videoWidth == width && context->draw.videoHeight == height))
+        return;
+
+    context->draw.videoWidth = width;
+    context->draw.videoHeight = height;
+    if (context->draw.vbo)
+        updateFitQuad(context);
+}
+
+// retained state of fit mode: nothing here is touched again by drawTextures()
+static void
+bindRetainedState(EGLContextType *context)
+{
+    GLProgram *glProgram = context->glProgram;
+    int i;
+
+    glBindBuffer(GL_ARRAY_BUFFER, context->draw.vbo);
+    glUseProgram(glProgram->program);
+    glEnableVertexAttribArray(glProgram->attrPosition);
+    glVertexAttribPointer(glProgram->attrPosition, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), (const GLvoid*)0);
+    glEnableVertexAttribArray(glProgram->attrTexCoord);
+    glVertexAttribPointer(glProgram->attrTexCoord, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), (const GLvoid*)(2 * sizeof(GLfloat)));
+    for (i = 0; i < glProgram->texCount; i++)
+        glUniform1i(glProgram->uniformTex[i], i);
+}
+
+int
+setDrawOptions(EGLContextType *context, const DrawOptions *options)
+{
+    DrawState *draw;
+
+    if (!context || !options)
+        return -1;
+    draw = &context->draw;
+    draw->options = *options;
+
+    if (options->swapInterval >= 0 && !eglSwapInterval(context->eglContext.display, options->swapInterval))
+        ERROR("eglSwapInterval(%d) failed\n", options->swapInterval);
+    // EGL doesn't expose the swap chain length, bound the frames queued ahead by fences instead
+    if (options->tripleBuffer) {
+        const char *extensions = eglQueryString(context->eglContext.display, EGL_EXTENSIONS);
+        draw->hasFenceSync = extensions && strstr(extensions, "EGL_KHR_fence_sync") != NULL;
+        if (!draw->hasFenceSync)
+            ERROR("EGL_KHR_fence_sync isn't supported, frames queued ahead are left to the driver\n");
+    }
+    if (!options->fit)
+        return 0;
+
+    if (!draw->vbo) {
+        glGenBuffers(1, &draw->vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, draw->vbo);
+        glBufferData(GL_ARRAY_BUFFER, 16 * sizeof(GLfloat), NULL, GL_DYNAMIC_DRAW);
+    }
+    bindRetainedState(context);
+
+    draw->surfaceWidth = draw->surfaceHeight = 0;
+    updateSurfaceSize(context);
+    if (!draw->surfaceWidth)
+        updateFitQuad(context);
+
+    return glGetError() == GL_NO_ERROR ? 0 : -1;
+}
+
+// fit mode: bind the textures, draw and swap; program, vbo, attributes and uniforms are already set
+static int
+drawTexturesRetained(EGLContextType *context, GLenum target, GLuint *textureIds, int texCount)
+{
+    DrawState *draw = &context->draw;
+    EGLDisplay display = context->eglContext.display;
+    EGLSyncKHR *fence = &draw->fences[draw->frameCount % MAX_FRAMES_IN_FLIGHT];
+    int i;
+
+    // the frame drawn MAX_FRAMES_IN_FLIGHT swaps ago must be done before another is queued
+    if (*fence != EGL_NO_SYNC_KHR) {
+        eglClientWaitSyncKHR(display, *fence, EGL_SYNC_FLUSH_COMMANDS_BIT_KHR, EGL_FOREVER_KHR);
+        eglDestroySyncKHR(display, *fence);
+        *fence = EGL_NO_SYNC_KHR;
+    }
+    if (!(draw->frameCount % SURFACE_CHECK_INTERVAL))
+        updateSurfaceSize(context);
+    draw->frameCount++;
+
+    // the quad covers every pixel unless letterboxed, no clear is needed then
+    if (draw->letterbox)
+        glClear(GL_COLOR_BUFFER_BIT);
+    for (i = 0; i < texCount; i++) {
+        glActiveTexture(GL_TEXTURE0 + i);
+        glBindTexture(target, textureIds[i]);
+    }
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+    if (eglSwapBuffers(display, context->eglContext.surface) != EGL_TRUE)
+        return -1;
+    if (draw->hasFenceSync)
+        *fence = eglCreateSyncKHR(display, EGL_SYNC_FENCE_KHR, NULL);
+
+    return 0;
+}
+
 #define MAX_RECT_SIZE 100
 #define MIN_RECT_SIZE 10
 
@@ -188,6 +396,11 @@ drawTextures(EGLContextType *context, GLenum target, GLuint *textureIds, int tex
         {  0.0f,  0.0f }
     };
 
+    if (context && context->draw.options.fit) {
+        ASSERT(texCount == context->glProgram->texCount);
+        return drawTexturesRetained(context, target, textureIds, texCount);
+    }
+
     if (direction) {
         rectSize1--;
         rectSize2++;
@@ -213,7 +426,7 @@ drawTextures(EGLContextType *context, GLenum target, GLuint *textureIds, int tex
     GLProgram *glProgram = context->glProgram;
 
     ASSERT(texCount == glProgram->texCount);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glClear(GL_COLOR_BUFFER_BIT);
 
     glUseProgram(glProgram->program);
     // glUniformMatrix4fv(program->proj_uniform, 1, GL_FALSE, egl->proj);
@@ -241,18 +454,47 @@ drawTextures(EGLContextType *context, GLenum target, GLuint *textureIds, int tex
     return 0;
 }
 
-EGLContextType *eglInit(Display *x11Display, XID x11Window, uint32_t fourcc, int isExternalTexture)
+static GLProgram*
+createVideoProgram(uint32_t fourcc, int isExternalTexture)
+{
+    if (isExternalTexture)
+        return createShaders(vertexShaderText_rgba, fragShaderText_rgba_ext, 1);
+    if (fourcc == YUV_FOURCC_I420)
+        return createShaders(vertexShaderText_rgba, fragShaderText_i420, 3);
+    if (fourcc == YUV_FOURCC_NV12)
+        return createShaders(vertexShaderText_rgba, fragShaderText_nv12, 2);
+    return createShaders(vertexShaderText_rgba, fragShaderText_rgba, 1);
+}
+
+// with the context current (a surface isn't needed)
+static int
+initVideoProgram(EGLContextType *context)
+{
+    const unsigned char* glVersion = glGetString(GL_VERSION);
+    INFO("Runing GL version: %s, please make sure it support GL 2.0 API", glVersion);
+
+    // clear to middle blue
+    // a single quad is drawn, no depth buffer
+    glClearColor(0.0, 0.0, 0.5, 0.0);
+    context->glProgram = createVideoProgram(context->fourcc, context->isExternalTexture);
+    CHECK_HANDLE_RET(context->glProgram, NULL, "createShaders", -1);
+    setYuvColorSpace(context, 0, 0);
+
+    return 0;
+}
+
+// display, config and context; shaders too if the context can be made current without a surface
+static EGLContextType*
+eglInitDisplay(EGLDisplay eglDisplay, int isWindow, uint32_t fourcc, int isExternalTexture)
 {
     EGLContextType *context = NULL;
-    GLProgram *glProgram = NULL;
 
-    context = calloc(1, sizeof(EGLContextType));
-    EGLDisplay eglDisplay = eglGetDisplay(x11Display);
-    if (eglDisplay == EGL_NO_DISPLAY) {
-        ERROR("eglGetDisplay fail");
-    }
     CHECK_HANDLE_RET(eglDisplay, EGL_NO_DISPLAY, "eglGetDisplay", NULL);
+    context = calloc(1, sizeof(EGLContextType));
     context->eglContext.display = eglDisplay;
+    context->eglContext.surface = EGL_NO_SURFACE;
+    context->fourcc = fourcc;
+    context->isExternalTexture = isExternalTexture;
 
     EGLint major, minor;
     EGLBoolean result = eglInitialize(eglDisplay, &major, &minor);
@@ -268,7 +510,7 @@ EGLContextType *eglInit(Display *x11Display, XID x11Window, uint32_t fourcc, int
          EGL_GREEN_SIZE, 8,
          EGL_BLUE_SIZE, 8,
          EGL_ALPHA_SIZE, 8,
-         EGL_DEPTH_SIZE, 8,
+         EGL_SURFACE_TYPE, isWindow ? EGL_WINDOW_BIT : EGL_PBUFFER_BIT,
          EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
          EGL_NONE
     };
@@ -276,55 +518,250 @@ EGLContextType *eglInit(Display *x11Display, XID x11Window, uint32_t fourcc, int
     EGLint eglConfigCount;
     result = eglChooseConfig(eglDisplay, eglConfigAttribs, &eglConfig, 1, &eglConfigCount);
     EGL_CHECK_RESULT_RET(result, "eglChooseConfig", NULL);
+    CHECK_HANDLE_RET(eglConfigCount, 0, "eglChooseConfig", NULL);
     context->eglContext.config = eglConfig;
 
-    EGLSurface eglSurface = eglCreateWindowSurface(eglDisplay, eglConfig, x11Window, NULL);
-    CHECK_HANDLE_RET(eglSurface, EGL_NO_SURFACE, "eglCreateWindowSurface", NULL);
-    context->eglContext.surface = eglSurface;
-
-    EGLint const eglContextAttribs[] = {
-        EGL_CONTEXT_CLIENT_VERSION, 2,
+    // prefer gles3 (pixel buffer object etc), gles2 api is still used for drawing
+    EGLint eglContextAttribs[] = {
+        EGL_CONTEXT_CLIENT_VERSION, 3,
         EGL_NONE
     };
     EGLContext eglContext = eglCreateContext(eglDisplay, eglConfig, EGL_NO_CONTEXT, eglContextAttribs);
+    context->glesVersion = 3;
+    if (eglContext == EGL_NO_CONTEXT) {
+        eglContextAttribs[1] = 2;
+        eglContext = eglCreateContext(eglDisplay, eglConfig, EGL_NO_CONTEXT, eglContextAttribs);
+        context->glesVersion = 2;
+    }
     CHECK_HANDLE_RET(eglContext, EGL_NO_CONTEXT, "eglCreateContext", NULL);
     context->eglContext.context = eglContext;
 
-    result = eglMakeCurrent(eglDisplay, eglSurface, eglSurface, eglContext);
-    EGL_CHECK_RESULT_RET(result, "eglMakeCurrent", NULL);
+    // otherwise the shaders wait for the surface
+    const char *extensions = eglQueryString(eglDisplay, EGL_EXTENSIONS);
+    if (extensions && strstr(extensions, "EGL_KHR_surfaceless_context") &&
+        eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, eglContext) == EGL_TRUE &&
+        initVideoProgram(context) < 0)
+        return NULL;
 
-    const unsigned char* glVersion = glGetString(GL_VERSION);
-    INFO("Runing GL version: %s, please make sure it support GL 2.0 API", glVersion);
+    return context;
+}
 
-    // clear to middle blue
-    glClearColor(0.0, 0.0, 0.5, 0.0);
-    glEnable(GL_DEPTH_TEST);
-    glClearDepthf(1.0f);
+EGLContextType *eglPrepare(Display *x11Display, uint32_t fourcc, int isExternalTexture)
+{
+    EGLDisplay eglDisplay;
+
+    if (x11Display) {
+        eglDisplay = eglGetDisplay(x11Display);
+        if (eglDisplay == EGL_NO_DISPLAY) {
+            ERROR("eglGetDisplay fail");
+        }
+    } else {
+        eglDisplay = getOffscreenEglDisplay();
+        if (eglDisplay == EGL_NO_DISPLAY) {
+            ERROR("no offscreen egl display");
+        }
+    }
+
+    return eglInitDisplay(eglDisplay, x11Display != NULL, fourcc, isExternalTexture);
+}
+
+int eglAttachSurface(EGLContextType *context, XID window, int width, int height)
+{
+    EGLDisplay eglDisplay;
+    EGLSurface eglSurface;
+    EGLBoolean result;
+
+    if (!context)
+        return -1;
+    eglDisplay = context->eglContext.display;
+    if (window) {
+        eglSurface = eglCreateWindowSurface(eglDisplay, context->eglContext.config, (EGLNativeWindowType)window, NULL);
+    } else {
+        EGLint const pbufferAttribs[] = {
+            EGL_WIDTH, width,
+            EGL_HEIGHT, height,
+            EGL_NONE
+        };
+        eglSurface = eglCreatePbufferSurface(eglDisplay, context->eglContext.config, pbufferAttribs);
+    }
+    CHECK_HANDLE_RET(eglSurface, EGL_NO_SURFACE, window ? "eglCreateWindowSurface" : "eglCreatePbufferSurface", -1);
+    context->eglContext.surface = eglSurface;
+
+    result = eglMakeCurrent(eglDisplay, eglSurface, eglSurface, context->eglContext.context);
+    EGL_CHECK_RESULT_RET(result, "eglMakeCurrent", -1);
+    if (!context->glProgram && initVideoProgram(context) < 0)
+        return -1;
     {
-        int width, height;
-        Window root;
-        int x, y, borderWidth, depth;
-        XGetGeometry(x11Display, x11Window, &root, &x, &y, &width, &height, &borderWidth, &depth);
-        glViewport(0, 0, width, height);
+        EGLint surfaceWidth = 0, surfaceHeight = 0;
+        eglQuerySurface(eglDisplay, eglSurface, EGL_WIDTH, &surfaceWidth);
+        eglQuerySurface(eglDisplay, eglSurface, EGL_HEIGHT, &surfaceHeight);
+        glViewport(0, 0, surfaceWidth, surfaceHeight);
+        context->draw.surfaceWidth = surfaceWidth;
+        context->draw.surfaceHeight = surfaceHeight;
     }
-    if (isExternalTexture)
-        glProgram = createShaders(vertexShaderText_rgba, fragShaderText_rgba_ext, 1);
-    else
-        glProgram = createShaders(vertexShaderText_rgba, fragShaderText_rgba, 1);
-    CHECK_HANDLE_RET(glProgram, NULL, "createShaders", NULL);
+
+    return 0;
+}
+
+int setTextureFormat(EGLContextType *context, uint32_t fourcc, int isExternalTexture)
+{
+    GLProgram *glProgram;
+
+    if (!context || !context->glProgram)
+        return -1;
+    if (context->isExternalTexture == isExternalTexture && (isExternalTexture || context->fourcc == fourcc))
+        return 0;
+
+    glProgram = createVideoProgram(fourcc, isExternalTexture);
+    CHECK_HANDLE_RET(glProgram, NULL, "createShaders", -1);
+    DEBUG("video program %.4s -> %.4s, external: %d\n", (char*)&context->fourcc, (char*)&fourcc, isExternalTexture);
+    releaseShader(context->glProgram);
     context->glProgram = glProgram;
+    context->fourcc = fourcc;
+    context->isExternalTexture = isExternalTexture;
+    setYuvColorSpace(context, 0, 0);
+    if (context->draw.options.fit && context->draw.vbo)
+        bindRetainedState(context);
 
+    return 1;
+}
+
+// draw a quad of the textures into the x, y, width, height rect of the bound framebuffer, then restore
+// the state drawTextures() expects. topRowFirst: the top row of the textures goes to framebuffer row 0
+// (read first by glReadPixels, sampled first as texture), otherwise to the top of the screen
+static int
+drawProgramQuad(EGLContextType *context, GLProgram *glProgram, GLenum target, GLuint *textureIds, int texCount,
+    int x, int y, int width, int height, int topRowFirst)
+{
+    int i;
+    static const GLfloat positions[4][2] = {
+        { -1.0f, -1.0f },
+        {  1.0f, -1.0f },
+        { -1.0f,  1.0f },
+        {  1.0f,  1.0f }
+    };
+    static const GLfloat texcoordsTopRowFirst[4][2] = {
+        {  0.0f,  0.0f },
+        {  1.0f,  0.0f },
+        {  0.0f,  1.0f },
+        {  1.0f,  1.0f }
+    };
+    static const GLfloat texcoordsScreen[4][2] = {
+        {  0.0f,  1.0f },
+        {  1.0f,  1.0f },
+        {  0.0f,  0.0f },
+        {  1.0f,  0.0f }
+    };
+
+    ASSERT(texCount == glProgram->texCount);
+    glViewport(x, y, width, height);
+    glUseProgram(glProgram->program);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glEnableVertexAttribArray(glProgram->attrPosition);
+    glVertexAttribPointer(glProgram->attrPosition, 2, GL_FLOAT, GL_FALSE, 0, positions);
+    glEnableVertexAttribArray(glProgram->attrTexCoord);
+    glVertexAttribPointer(glProgram->attrTexCoord, 2, GL_FLOAT, GL_FALSE, 0, topRowFirst ? texcoordsTopRowFirst : texcoordsScreen);
+    for (i = 0; i < texCount; i++) {
+        glActiveTexture(GL_TEXTURE0 + i);
+        glBindTexture(target, textureIds[i]);
+        glUniform1i(glProgram->uniformTex[i], i);
+    }
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+    glViewport(0, 0, context->draw.surfaceWidth, context->draw.surfaceHeight);
+    if (context->draw.options.fit) {
+        bindRetainedState(context);
+    } else {
+        glDisableVertexAttribArray(glProgram->attrTexCoord);
+        glDisableVertexAttribArray(glProgram->attrPosition);
+        glUseProgram(0);
+    }
+
+    return 0;
+}
+
+static GLProgram*
+getRgbProgram(EGLContextType *context)
+{
+    if (!context->rgbProgram)
+        context->rgbProgram = createShaders(vertexShaderText_rgba, fragShaderText_rgba, 1);
+    return context->rgbProgram;
+}
+
+int
+drawTexturesOffscreen(EGLContextType *context, GLenum target, GLuint *textureIds, int texCount, int x, int y, int width, int height)
+{
+    if (!context)
+        return -1;
+
+    return drawProgramQuad(context, context->glProgram, target, textureIds, texCount, x, y, width, height, 1);
+}
+
+int
+drawTextureOffscreenRgb(EGLContextType *context, GLuint textureId, int x, int y, int width, int height)
+{
+    if (!context)
+        return -1;
+    CHECK_HANDLE_RET(getRgbProgram(context), NULL, "createShaders", -1);
+
+    return drawProgramQuad(context, context->rgbProgram, GL_TEXTURE_2D, &textureId, 1, x, y, width, height, 1);
+}
+
+int
+presentTextureRgb(EGLContextType *context, GLuint textureId)
+{
+    if (!context)
+        return -1;
+    CHECK_HANDLE_RET(getRgbProgram(context), NULL, "createShaders", -1);
+
+    drawProgramQuad(context, context->rgbProgram, GL_TEXTURE_2D, &textureId, 1,
+        0, 0, context->draw.surfaceWidth, context->draw.surfaceHeight, 0);
+    if (eglSwapBuffers(context->eglContext.display, context->eglContext.surface) != EGL_TRUE)
+        return -1;
+
+    return 0;
+}
+
+EGLContextType *eglInit(Display *x11Display, XID x11Window, uint32_t fourcc, int isExternalTexture)
+{
+    EGLContextType *context = eglPrepare(x11Display, fourcc, isExternalTexture);
+
+    if (context && eglAttachSurface(context, x11Window, 0, 0) < 0) {
+        eglRelease(context);
+        return NULL;
+    }
+    return context;
+}
+
+EGLContextType *eglInitOffscreen(int width, int height, uint32_t fourcc, int isExternalTexture)
+{
+    EGLContextType *context = eglPrepare(NULL, fourcc, isExternalTexture);
+
+    if (context && eglAttachSurface(context, 0, width, height) < 0) {
+        eglRelease(context);
+        return NULL;
+    }
     return context;
 }
 
 void eglRelease(EGLContextType *context)
 {
+    int i;
+
     if (!context)
         return;
 
+    for (i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        if (context->draw.fences[i] != EGL_NO_SYNC_KHR)
+            eglDestroySyncKHR(context->eglContext.display, context->draw.fences[i]);
+    }
+    if (context->draw.vbo)
+        glDeleteBuffers(1, &context->draw.vbo);
     releaseShader(context->glProgram);
+    releaseShader(context->rgbProgram);
     eglMakeCurrent(context->eglContext.display, NULL, NULL, NULL);
-    eglDestroySurface(context->eglContext.display, context->eglContext.surface);
+    if (context->eglContext.surface != EGL_NO_SURFACE)
+        eglDestroySurface(context->eglContext.display, context->eglContext.surface);
     eglDestroyContext(context->eglContext.display, context->eglContext.context);
     eglTerminate(context->eglContext.display);
     free(context);
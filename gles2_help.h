@@ -33,6 +33,14 @@
 #define GL_GLEXT_PROTOTYPES
 #include <GLES2/gl2ext.h>
 
+#ifndef YUV_FOURCC
+#define YUV_FOURCC(ch0, ch1, ch2, ch3) \
+    ((uint32_t)(uint8_t)(ch0) | ((uint32_t)(uint8_t)(ch1) << 8) | \
+    ((uint32_t)(uint8_t)(ch2) << 16) | ((uint32_t)(uint8_t)(ch3) << 24 ))
+#define YUV_FOURCC_I420 YUV_FOURCC('I', '4', '2', '0')
+#define YUV_FOURCC_NV12 YUV_FOURCC('N', 'V', '1', '2')
+#endif
+
 typedef struct {
     EGLDisplay          display;
     EGLConfig           config;
@@ -48,11 +56,39 @@ typedef struct {
     GLint   attrTexCoord;
     GLint   uniformTex[3];
     int     texCount;
+    GLint   uniformColorMatrix;     // yuv shaders only
+    GLint   uniformColorOffset;
 } GLProgram;
 
+// drawTextures() behaviour, see setDrawOptions()
+typedef struct {
+    int     fit;            // retained fast path: video scaled to the window keeping its aspect ratio; 0: animated zoom demo
+    int     swapInterval;   // eglSwapInterval(), 0: don't wait for vblank; -1: EGL default
+    int     tripleBuffer;   // fit mode: at most two frames queued ahead of the display, throttled by fences
+} DrawOptions;
+
+#define MAX_FRAMES_IN_FLIGHT 2
+typedef struct {
+    DrawOptions     options;
+    GLuint          vbo;            // fit mode quad: interleaved position + texcoord
+    int             videoWidth;
+    int             videoHeight;
+    int             surfaceWidth;
+    int             surfaceHeight;
+    int             letterbox;      // the quad doesn't cover the surface, bars are cleared every frame
+    int             frameCount;
+    EGLSyncKHR      fences[MAX_FRAMES_IN_FLIGHT];
+    int             hasFenceSync;
+} DrawState;
+
 typedef struct {
     EGLContext_t    eglContext;
     GLProgram       *glProgram;
+    GLProgram       *rgbProgram;    // fbo to fbo draws, created on first use
+    int             glesVersion;    // major version of the created context, PBOs etc need 3
+    uint32_t        fourcc;         // texture format of glProgram, see setTextureFormat()
+    int             isExternalTexture;
+    DrawState       draw;
 } EGLContextType;
 
 #ifdef __cplusplus
@@ -60,9 +96,31 @@ extern "C" {
 #endif /* __cplusplus */
 
 EGLContextType* eglInit(Display *x11Display, XID window, uint32_t fourcc, int isExternalTexture);
+// headless: pbuffer surface of a surfaceless display, drawTextures() renders there and swap is a no-op
+EGLContextType* eglInitOffscreen(int width, int height, uint32_t fourcc, int isExternalTexture);
+// in two steps, e.g. display, context and shaders while the video size isn't known yet:
+// x11Display NULL: surfaceless display for a pbuffer
+EGLContextType* eglPrepare(Display *x11Display, uint32_t fourcc, int isExternalTexture);
+// then the window surface, or a width x height pbuffer if window is 0
+int eglAttachSurface(EGLContextType *context, XID window, int width, int height);
 void eglRelease(EGLContextType *context);
 GLuint createTextureFromPixmap(EGLContextType *context, XID pixmap);
 int drawTextures(EGLContextType *context, GLenum target, GLuint *textureIds, int texCount);
+// draw into the x, y, width, height rect of the bound framebuffer object without swap, top row first for glReadPixels
+int drawTexturesOffscreen(EGLContextType *context, GLenum target, GLuint *textureIds, int texCount, int x, int y, int width, int height);
+// same for an rgba texture (e.g. of another fbo, its top row first as well), not color converted
+int drawTextureOffscreenRgb(EGLContextType *context, GLuint textureId, int x, int y, int width, int height);
+// draw an rgba texture of an fbo (top row first) to the whole surface and swap
+int presentTextureRgb(EGLContextType *context, GLuint textureId);
+// fit mode binds program, vbo and attributes once, drawTextures() then only binds textures, draws and swaps
+int setDrawOptions(EGLContextType *context, const DrawOptions *options);
+// video size for the aspect ratio of fit mode, cheap when unchanged
+void setDrawVideoSize(EGLContextType *context, int width, int height);
+// switch the video program if the textures aren't what eglPrepare() guessed, return 1 if it changed
+// (the color space is reset)
+int setTextureFormat(EGLContextType *context, uint32_t fourcc, int isExternalTexture);
+// yuv -> rgb matrix of the yuv shaders: BT.601 or BT.709, limited (16-235) or full range
+void setYuvColorSpace(EGLContextType *context, int isBT709, int isFullRange);
 
 #ifdef __cplusplus
 }
@@ -22,10 +22,17 @@
 
 #include <string.h>
 #include <unistd.h>
+#include <pthread.h>
 #include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
 #include <libavutil/frame.h>
+#include <libavutil/time.h>
 #include "video_gl_render.h"
+#include "player_queue.h"
+#include "player_scheduler.h"
+#include "player_latency.h"
+#include "player_dump.h"
+#include "player_io.h"
 #if LIBAVCODEC_VERSION_INT < AV_VERSION_INT(55, 28, 1)
     #define av_frame_alloc avcodec_alloc_frame
     #if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(54, 28, 0)
@@ -34,26 +41,256 @@
         #define av_frame_free av_freep
     #endif
 #endif
+#if LIBAVCODEC_VERSION_INT < AV_VERSION_INT(57, 8, 0)
+    #define av_packet_unref av_free_packet
+#endif
+
+#define PACKET_QUEUE_SIZE   16
+#define FRAME_QUEUE_SIZE    4
+#define MAX_STREAMS         64
+#define MAX_SEEKS           64
+
+// seek_index >= 0: no data, decoder is flushed and frames before seek_target are dropped
+typedef struct {
+    AVPacket pkt;
+    int64_t demux_time;
+    int seek_index;
+    int64_t seek_target;    // in stream time base
+    int64_t seek_start;     // wall time the seek was issued
+} PlayerPacket;
+
+typedef struct {
+    int64_t target;         // in stream time base
+    int64_t first_pts;      // first frame shown after the seek
+    int64_t latency;        // us from seek to the first frame shown, -1: not reached
+} SeekResult;
+
+typedef struct {
+    const char *name;
+    int count;
+    int64_t busy_time;  // us spent in the stage's own work, excluding waits on the queues
+    int64_t start_time;
+    int64_t end_time;
+} StageStats;
+
+// one demux/decode session
+typedef struct {
+    int index;
+    const char *input_file;
+    AVFormatContext *format_ctx;
+    InputReader *input_reader;  // custom avio, NULL: avformat file protocol
+    AVCodecContext *video_dec_ctx;
+    int video_stream_index;
+    AVRational time_base;
+
+    // demux --> packet_queue --> decode (pool worker)
+    PlayerQueue *packet_queue;
+    pthread_t demux_thread_id;
+    int demux_started;
+
+    StageStats demux_stats;
+    StageStats decode_stats;
+    StageStats sink_stats;      // updated by the sink
+    PresentScheduler scheduler;
+    LatencyTracker latency;     // null sink mode only
+    DumpWriter *dump_writer;
+    int thumbnail_frames;       // frames seen by the thumbnail sink
+    int thumbnail_count;        // thumbnails read back
+
+    StartupTiming startup;
 
-static char* input_file = NULL;
+    SeekResult seeks[MAX_SEEKS];
+    int seek_done;              // index of the last seek that reached the sink, set by the sink
+
+    int opened;
+    int sink_done;              // the sink got all frames of the session, decoder can be closed
+} PlayerStream;
+
+// frame_queue item, frame NULL marks the end of a session
+typedef struct {
+    AVFrame *frame;
+    PlayerStream *stream;
+    FrameTiming *timing;
+    int seek_index;         // >= 0: first frame after that seek
+    int64_t seek_start;
+} PlayerFrame;
+
+typedef struct {
+    PlayerStream *streams;
+    int stream_count;
+    int next_stream;            // next session picked by a pool worker
+
+    pthread_t *worker_thread_ids;
+    int worker_count;
+    int active_workers;         // the last worker finishes frame_queue
+
+    // all sessions --> frame_queue --> sink (main thread, it owns the EGL context)
+    PlayerQueue *frame_queue;
+    StageStats sink_stats;
+    int track_latency;
+
+    pthread_mutex_t sink_mutex;
+    pthread_cond_t sink_cond;
+    int sink_exited;
+} PlayerContext;
+
+static const char* input_files[MAX_STREAMS];
+static int input_count = 0;
 static int render_mode = 0;
+static int zero_copy = 0;
+static int free_run = 0;
+// gl draw path of modes 1-3
+static int draw_fit = 0;
+static int swap_interval = -1;
+static int triple_buffer = 0;
+static int offscreen = 0;
+// demux of each session
+static int fast_start = 0;
+#define FAST_START_PROBE_SIZE       "262144"    // bytes, default 5000000
+#define FAST_START_ANALYZE_DURATION "200000"    // us, default 5 s
+static int io_buffer_size = 0;  // bytes, 0: avformat file protocol
+// video wall of modes 1-3: one tile per input
+#define MOSAIC_REFRESH_US 16667
+static int mosaic = 0;
+static int mosaic_cols = 0;     // 0: square grid large enough for the inputs
+static int mosaic_rows = 0;
+static int mosaic_width = 1920;
+static int mosaic_height = 1080;
+// thumbnail sink (mode 5)
+#define MAX_THUMBNAIL_SIZES 8
+static int thumbnail_sizes[MAX_THUMBNAIL_SIZES * 2] = { 320, 180 };   // width, height pairs
+static int thumbnail_size_count = 1;
+static int thumbnail_interval = 1;
+static int worker_count = 0;
+static char* json_file = NULL;
+static char* dump_file = NULL;
+static char* list_file = NULL;
+static char* codec_options = NULL; // key=value,... passed to avcodec_open2()
+// libyami_h264 tuning, NULL: decoder default
+static const char* queue_depth = NULL;
+static const char* extra_surfaces = NULL;
+static const char* low_delay = NULL;
+static const char* thread_affinity = NULL;
+static const char* thread_priority = NULL;
+static double seek_times[MAX_SEEKS]; // seconds
+static int seek_count = 0;
+// avformat/avcodec open and close aren't guaranteed thread safe by the old lock manager
+static pthread_mutex_t open_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 static void print_help(const char* app)
 {
     PRINTF("%s <options>\n", app);
-    PRINTF("   -i media file to decode\n");
+    PRINTF("   -i media file to decode, repeat it to decode multiple files concurrently\n");
+    PRINTF("   -l <file> list of media files to decode, one per line\n");
+    PRINTF("   -w <workers> number of concurrent decode sessions, default: min(inputs, cpus)\n");
     PRINTF("   -m <render mode>\n");
-    PRINTF("      0: dump video frame to file\n");
-    PRINTF("      1: upload raw video frame (Y) as texture\n");
+    PRINTF("      0: dump video frame to file (on a writer thread)\n");
+    PRINTF("      1: upload raw video frame (YUV) as textures\n");
     PRINTF("      2: texture: export video frame as drm name (RGBX) + texture from drm name\n");
     PRINTF("      3: texture: export video frame as dma_buf(RGBX) + texutre from dma_buf\n");
+    PRINTF("      4: null sink: release decoded frames, report fps and per stage latency as json (no X display needed)\n");
+    PRINTF("      5: thumbnail sink: frames scaled by gl and read back as rgb, -o <prefix> writes <prefix>_<stream>_<n>[_<w>x<h>].ppm (offscreen)\n");
+    PRINTF("   -z raw video frame (mode 0/1) references decoder surface instead of a copy\n");
+    PRINTF("   -n render frames as fast as possible instead of at their pts (always on for mode 0/4/5)\n");
+    PRINTF("   -j <file> write the json report of mode 4 to file instead of stdout\n");
+    PRINTF("   -o <file> dump file of mode 0, default ./dump_<width>x<height>.I420; *.y4m writes y4m\n");
+    PRINTF("   -r <w>x<h>[,<w>x<h>...] thumbnail sizes of mode 5, rendered in one pass from one upload, default 320x180\n");
+    PRINTF("   -k <n> mode 5 reads back every n-th frame, default 1\n");
+    PRINTF("   -s <t1,t2,...> seek to each time (seconds) in turn, report seek to first frame latency\n");
+    PRINTF("   -c <key=value,...> decoder options, e.g. backend=sw,sw_surfaces=4 runs libyami_h264 on the software decoder\n");
+    PRINTF("   -q <n> input packets queued ahead of the decode thread (throughput), default 4\n");
+    PRINTF("   -e <n> extra decoder surfaces for frames held by the player\n");
+    PRINTF("   -d low delay: each packet's frame is returned by the same decode call (latency)\n");
+    PRINTF("   -a <mask> cpu mask of the decode thread, e.g. 0x4\n");
+    PRINTF("   -p <priority> SCHED_FIFO priority (1-99) of the decode thread\n");
+    PRINTF("   -f fit: retained gl draw path, video scaled to the window keeping its aspect ratio (mode 1-3)\n");
+    PRINTF("   -v <n> swap interval, 0 doesn't wait for vblank (mode 1-3)\n");
+    PRINTF("   -t triple buffering: with -f, two frames queued ahead of the display (mode 1-3)\n");
+    PRINTF("   -g <cols>x<rows>[,<width>x<height>] video wall of modes 1-3, one tile per input, default with multiple inputs:\n");
+    PRINTF("      square grid in 1920x1080\n");
+    PRINTF("   -b fast start: bounded stream probing, skipped when the container header has the video parameters\n");
+    PRINTF("   -u <KiB> input i/o by the player with an avio buffer of that size: files are mmap'ed, pipes ('-': stdin) are\n");
+    PRINTF("      read ahead by a thread\n");
+    PRINTF("   -x offscreen: render to an EGL pbuffer without X display, e.g. llvmpipe with LIBGL_ALWAYS_SOFTWARE=1 (mode 1-3)\n");
+}
+
+static int parse_thumbnail_sizes(const char *list)
+{
+    int width, height, n;
+
+    thumbnail_size_count = 0;
+    while (*list) {
+        if (thumbnail_size_count >= MAX_THUMBNAIL_SIZES) {
+            ERROR("at most %d thumbnail sizes are supported\n", MAX_THUMBNAIL_SIZES);
+            return -1;
+        }
+        if (sscanf(list, "%dx%d%n", &width, &height, &n) != 2 || width <= 0 || height <= 0)
+            return -1;
+        thumbnail_sizes[2 * thumbnail_size_count] = width;
+        thumbnail_sizes[2 * thumbnail_size_count + 1] = height;
+        thumbnail_size_count++;
+        list += n;
+        if (*list == ',')
+            list++;
+    }
+
+    return thumbnail_size_count ? 0 : -1;
+}
+
+static void parse_seek_times(const char *list)
+{
+    char *end;
+
+    while (*list && seek_count < MAX_SEEKS) {
+        seek_times[seek_count] = strtod(list, &end);
+        if (end == list)
+            break;
+        seek_count++;
+        list = *end == ',' ? end + 1 : end;
+    }
+}
+
+static int add_input(const char *file)
+{
+    if (input_count >= MAX_STREAMS) {
+        ERROR("too many inputs, at most %d are supported\n", MAX_STREAMS);
+        return -1;
+    }
+    input_files[input_count++] = file;
+
+    return 0;
+}
+
+static int read_input_list(const char *file)
+{
+    char line[1024];
+    size_t len;
+    FILE *fp = fopen(file, "r");
+
+    if (!fp) {
+        ERROR("fail to open input list: %s\n", file);
+        return -1;
+    }
+    while (fgets(line, sizeof(line), fp)) {
+        len = strcspn(line, "\r\n");
+        line[len] = '\0';
+        if (!len || line[0] == '#')
+            continue;
+        if (add_input(strdup(line)) < 0) {
+            fclose(fp);
+            return -1;
+        }
+    }
+    fclose(fp);
+
+    return 0;
 }
 
 static int process_cmdline(int argc, char *argv[])
 {
     char opt;
 
-    while ((opt = getopt(argc, argv, "h:m:i:?")) != -1)
+    while ((opt = getopt(argc, argv, "h:m:i:l:w:znj:o:r:k:s:c:q:e:da:p:fv:tg:xbu:?")) != -1)
     {
         switch (opt) {
         case 'h':
@@ -61,161 +298,925 @@ static int process_cmdline(int argc, char *argv[])
             print_help (argv[0]);
             return -1;
         case 'i':
-            input_file = optarg;
+            if (add_input(optarg) < 0)
+                return -1;
+            break;
+        case 'l':
+            list_file = optarg;
+            break;
+        case 'w':
+            worker_count = atoi(optarg);
             break;
         case 'm':
             render_mode = atoi(optarg);
             break;
+        case 'z':
+            zero_copy = 1;
+            break;
+        case 'n':
+            free_run = 1;
+            break;
+        case 'j':
+            json_file = optarg;
+            break;
+        case 'o':
+            dump_file = optarg;
+            break;
+        case 'r':
+            if (parse_thumbnail_sizes(optarg) < 0) {
+                ERROR("invalid thumbnail sizes: %s\n", optarg);
+                return -1;
+            }
+            break;
+        case 'k':
+            thumbnail_interval = atoi(optarg);
+            if (thumbnail_interval <= 0)
+                thumbnail_interval = 1;
+            break;
+        case 's':
+            parse_seek_times(optarg);
+            break;
+        case 'c':
+            codec_options = optarg;
+            break;
+        case 'q':
+            queue_depth = optarg;
+            break;
+        case 'e':
+            extra_surfaces = optarg;
+            break;
+        case 'd':
+            low_delay = "1";
+            break;
+        case 'a':
+            thread_affinity = optarg;
+            break;
+        case 'p':
+            thread_priority = optarg;
+            break;
+        case 'f':
+            draw_fit = 1;
+            break;
+        case 'v':
+            swap_interval = atoi(optarg);
+            break;
+        case 't':
+            triple_buffer = 1;
+            break;
+        case 'x':
+            offscreen = 1;
+            break;
+        case 'b':
+            fast_start = 1;
+            break;
+        case 'u':
+            io_buffer_size = atoi(optarg) * 1024;
+            break;
+        case 'g':
+            mosaic = 1;
+            if (sscanf(optarg, "%dx%d,%dx%d", &mosaic_cols, &mosaic_rows, &mosaic_width, &mosaic_height) < 2) {
+                ERROR("invalid mosaic grid: %s\n", optarg);
+                return -1;
+            }
+            break;
         default:
             print_help(argv[0]);
             break;
         }
     }
-    PRINTF("input file: %s, render_mode: %d\n", input_file, render_mode);
+    if (list_file && read_input_list(list_file) < 0)
+        return -1;
+    if (input_count > 1 && render_mode >= 1 && render_mode <= 3)
+        mosaic = 1;
+    if (mosaic && !mosaic_cols) {
+        while (mosaic_cols * mosaic_cols < input_count)
+            mosaic_cols++;
+        mosaic_rows = mosaic_cols;
+    }
+    // every tile is decoded at the same time
+    if (mosaic && worker_count <= 0)
+        worker_count = input_count;
+    if (worker_count <= 0) {
+        worker_count = sysconf(_SC_NPROCESSORS_ONLN);
+        if (worker_count <= 0)
+            worker_count = 1;
+    }
+    if (worker_count > input_count)
+        worker_count = input_count;
+    PRINTF("input files: %d, workers: %d, render_mode: %d, zero_copy: %d, free_run: %d, seeks: %d\n",
+        input_count, worker_count, render_mode, zero_copy, free_run, seek_count);
 
     return 0;
 }
 
-int main(int argc, char *argv[])
+static void free_packet(void *item)
 {
-    AVCodecContext* video_dec_ctx = NULL;
-    AVCodec* video_dec = NULL;
-    AVPacket pkt;
-    AVFrame *frame = NULL;
-    int read_eos = 0;
-    int decode_count = 0;
-    int render_count = 0;
-    int video_stream_index = -1, i;
-    uint8_t *frame_copy = NULL;
-    FILE *dump_yuv = NULL;
+    PlayerPacket *pkt = (PlayerPacket*)item;
 
-    // parse command line parameters
-    process_cmdline(argc, argv);
-    if (!input_file) {
-        ERROR("no input file specified\n");
+    av_packet_unref(&pkt->pkt);
+    av_free(pkt);
+}
+
+static void free_player_frame(void *item)
+{
+    PlayerFrame *frame = (PlayerFrame*)item;
+
+    if (frame->frame)
+        av_frame_free(&frame->frame);
+    av_free(frame->timing);
+    av_free(frame);
+}
+
+static void stage_begin(StageStats *stats, const char *name)
+{
+    stats->name = name;
+    stats->start_time = av_gettime();
+}
+
+static void stage_end(StageStats *stats)
+{
+    stats->end_time = av_gettime();
+}
+
+static void print_stage_stats(StageStats *stats)
+{
+    int64_t elapsed = stats->end_time - stats->start_time;
+
+    PRINTF("%s stage: %d items, %.2f items/s, busy %.2f ms (%.1f%%)\n", stats->name, stats->count,
+        elapsed > 0 ? stats->count * 1000000.0 / elapsed : 0.0,
+        stats->busy_time / 1000.0, elapsed > 0 ? stats->busy_time * 100.0 / elapsed : 0.0);
+}
+
+// seek demuxer to the key frame before seek_times[index], and tell decode to flush
+static int seek_stream(PlayerStream *stream, int index)
+{
+    AVStream *st = stream->format_ctx->streams[stream->video_stream_index];
+    SeekResult *result = &stream->seeks[index];
+    PlayerPacket *marker;
+    int64_t start = av_gettime();
+
+    result->target = av_rescale_q((int64_t)(seek_times[index] * AV_TIME_BASE), AV_TIME_BASE_Q, st->time_base);
+    if (st->start_time != AV_NOPTS_VALUE)
+        result->target += st->start_time;
+    result->first_pts = AV_NOPTS_VALUE;
+    result->latency = -1;
+    if (av_seek_frame(stream->format_ctx, stream->video_stream_index, result->target, AVSEEK_FLAG_BACKWARD) < 0) {
+        ERROR("fail to seek %s to %.3f s\n", stream->input_file, seek_times[index]);
+        __atomic_store_n(&stream->seek_done, index, __ATOMIC_RELEASE);
+        return 0;
+    }
+
+    marker = av_mallocz(sizeof(PlayerPacket));
+    if (!marker)
+        return -1;
+    av_init_packet(&marker->pkt);
+    marker->seek_index = index;
+    marker->seek_target = result->target;
+    marker->seek_start = start;
+    if (queue_push(stream->packet_queue, marker) < 0) {
+        free_packet(marker);
         return -1;
     }
 
-    // libav* init
-    av_register_all();
+    return 0;
+}
 
-    // open input file
-    AVFormatContext* pFormat = NULL;
-    if (avformat_open_input(&pFormat, input_file, NULL, NULL) < 0) {
-        ERROR("fail to open input file: %s by avformat\n", input_file);
-        return -1;
+static void* demux_thread(void *arg)
+{
+    PlayerStream *stream = (PlayerStream*)arg;
+    AVPacket pkt;
+    PlayerPacket *video_pkt;
+    int seek_index = -1;
+    int64_t t;
+
+    stage_begin(&stream->demux_stats, "demux");
+    av_init_packet(&pkt);
+    stream->seek_done = -1;
+    if (seek_count && seek_stream(stream, ++seek_index) < 0)
+        goto out;
+
+    while (1) {
+        // next seek once the first frame of the current one is shown, stop after the last one
+        if (seek_index >= 0 && __atomic_load_n(&stream->seek_done, __ATOMIC_ACQUIRE) == seek_index) {
+            if (seek_index + 1 == seek_count)
+                break;
+            if (seek_stream(stream, ++seek_index) < 0)
+                break;
+        }
+
+        t = av_gettime();
+        if (av_read_frame(stream->format_ctx, &pkt) < 0) {
+            // seek target beyond the end of stream, go on with the next seek
+            if (seek_index >= 0 && seek_index + 1 < seek_count) {
+                if (seek_stream(stream, ++seek_index) < 0)
+                    break;
+                continue;
+            }
+            break;
+        }
+
+        if (pkt.stream_index != stream->video_stream_index) {
+            av_packet_unref(&pkt);
+            continue;
+        }
+        if (!stream->startup.first_packet)
+            stream->startup.first_packet = av_gettime();
+
+        // the packet outlives the next av_read_frame(), make sure it owns its data
+        video_pkt = av_malloc(sizeof(PlayerPacket));
+        if (!video_pkt) {
+            av_packet_unref(&pkt);
+            break;
+        }
+        video_pkt->pkt = pkt;
+        video_pkt->demux_time = av_gettime();
+        video_pkt->seek_index = -1;
+#if LIBAVCODEC_VERSION_INT < AV_VERSION_INT(57, 8, 0)
+        av_dup_packet(&video_pkt->pkt);
+#endif
+        stream->demux_stats.busy_time += av_gettime() - t;
+        stream->demux_stats.count++;
+
+        if (queue_push(stream->packet_queue, video_pkt) < 0) {
+            free_packet(video_pkt);
+            break;
+        }
     }
-    if (avformat_find_stream_info(pFormat, NULL) < 0) {
+
+out:
+    queue_finish(stream->packet_queue);
+    stage_end(&stream->demux_stats);
+
+    return NULL;
+}
+
+// the demuxer drops the packets of the other streams instead of returning them to be unref'ed
+static void discard_other_streams(AVFormatContext *format_ctx, int video_stream_index)
+{
+    int i;
+
+    for (i = 0; i < format_ctx->nb_streams; i++) {
+        if (i != video_stream_index)
+            format_ctx->streams[i]->discard = AVDISCARD_ALL;
+    }
+}
+
+// the container header (e.g. mp4 moov) already tells what the decoder needs, no packet has to be probed
+static int has_video_params(AVCodecContext *video_dec_ctx)
+{
+    return video_dec_ctx->codec_id != AV_CODEC_ID_NONE && video_dec_ctx->width && video_dec_ctx->height;
+}
+
+static int open_stream(PlayerContext *player, PlayerStream *stream)
+{
+    AVFormatContext *format_ctx = NULL;
+    AVCodecContext *video_dec_ctx = NULL;
+    AVCodec *video_dec = NULL;
+    AVDictionary *format_opts = NULL;
+    AVDictionary *codec_opts = NULL;
+    int index = -1, ret = -1;
+
+    stream->startup.open_start = av_gettime();
+    pthread_mutex_lock(&open_mutex);
+    stream->startup.open_locked = av_gettime();
+    // open input file, fast start bounds the bytes and the duration read to probe the streams
+    if (fast_start) {
+        av_dict_set(&format_opts, "probesize", FAST_START_PROBE_SIZE, 0);
+        av_dict_set(&format_opts, "analyzeduration", FAST_START_ANALYZE_DURATION, 0);
+    }
+    if (io_buffer_size > 0) {
+        stream->input_reader = input_reader_open(stream->input_file, io_buffer_size);
+        format_ctx = stream->input_reader ? avformat_alloc_context() : NULL;
+        if (!format_ctx) {
+            av_dict_free(&format_opts);
+            goto out;
+        }
+        format_ctx->pb = input_reader_get_avio(stream->input_reader);
+    }
+    if (avformat_open_input(&format_ctx, stream->input_file, NULL, &format_opts) < 0) {
+        ERROR("fail to open input file: %s by avformat\n", stream->input_file);
+        av_dict_free(&format_opts);
+        goto out;
+    }
+    av_dict_free(&format_opts);
+    stream->format_ctx = format_ctx;
+    stream->startup.input_opened = av_gettime();
+    if (fast_start && format_ctx->nb_streams)
+        index = av_find_best_stream(format_ctx, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+    // audio/subtitle streams known from the header aren't probed either
+    if (index >= 0)
+        discard_other_streams(format_ctx, index);
+    if ((index < 0 || !has_video_params(format_ctx->streams[index]->codec)) &&
+        avformat_find_stream_info(format_ctx, NULL) < 0) {
         ERROR("fail to find out stream info\n");
-        return -1;
+        goto out;
     }
-    av_dump_format(pFormat,0,input_file,0);
+    stream->startup.info_found = av_gettime();
+    av_dump_format(format_ctx, stream->index, stream->input_file, 0);
 
     // find out video stream
-    for (i = 0; i < pFormat->nb_streams; i++) {
-        if (pFormat->streams[i]->codec->codec_type == AVMEDIA_TYPE_VIDEO) {
-            video_dec_ctx = pFormat->streams[i]->codec;
-            video_stream_index = i;
-            break;
-        }
+    index = av_find_best_stream(format_ctx, AVMEDIA_TYPE_VIDEO, -1, -1, &video_dec, 0);
+    if (index < 0) {
+        ERROR("no video stream in %s\n", stream->input_file);
+        goto out;
     }
-    ASSERT(video_dec_ctx && video_stream_index>=0);
+    stream->video_stream_index = index;
+    video_dec_ctx = format_ctx->streams[index]->codec;
+    if (fast_start)
+        discard_other_streams(format_ctx, index);
 
     // open video codec
-    video_dec = avcodec_find_decoder(video_dec_ctx->codec_id);
-    video_dec_ctx->coder_type = render_mode ? render_mode -1 : render_mode; // specify output frame type
-    if (avcodec_open2(video_dec_ctx, video_dec, NULL) < 0) {
+    // frames are handed over to the sink thread, they must hold their own reference
+    video_dec_ctx->refcounted_frames = 1;
+    av_dict_set(&codec_opts, "output_type", render_mode == 2 ? "drm" : render_mode == 3 ? "dmabuf" : "raw", 0);
+    if (zero_copy)
+        av_dict_set(&codec_opts, "zero_copy", "1", 0);
+    av_dict_set(&codec_opts, "queue_depth", queue_depth, 0); // NULL value: not set
+    av_dict_set(&codec_opts, "extra_surfaces", extra_surfaces, 0);
+    av_dict_set(&codec_opts, "low_delay", low_delay, 0);
+    av_dict_set(&codec_opts, "decode_thread_affinity", thread_affinity, 0);
+    av_dict_set(&codec_opts, "decode_thread_priority", thread_priority, 0);
+    if (codec_options && av_dict_parse_string(&codec_opts, codec_options, "=", ",", 0) < 0) {
+        ERROR("invalid decoder options: %s\n", codec_options);
+        av_dict_free(&codec_opts);
+        goto out;
+    }
+    if (avcodec_open2(video_dec_ctx, video_dec, &codec_opts) < 0) {
         ERROR("fail to open codec\n");
+        av_dict_free(&codec_opts);
+        goto out;
+    }
+    av_dict_free(&codec_opts);
+    stream->startup.codec_opened = av_gettime();
+    stream->video_dec_ctx = video_dec_ctx;
+    stream->time_base = format_ctx->streams[stream->video_stream_index]->time_base;
+    stream->opened = 1;
+    ret = 0;
+
+out:
+    pthread_mutex_unlock(&open_mutex);
+    if (ret < 0)
+        return ret;
+
+    scheduler_init(&stream->scheduler, !free_run && render_mode >= 1 && render_mode <= 3,
+        format_ctx->streams[stream->video_stream_index]->time_base,
+        format_ctx->streams[stream->video_stream_index]->avg_frame_rate);
+    stage_begin(&stream->sink_stats, "sink");
+    stream->packet_queue = queue_create(PACKET_QUEUE_SIZE);
+    if (!stream->packet_queue || pthread_create(&stream->demux_thread_id, NULL, demux_thread, stream)) {
+        ERROR("fail to create demux thread\n");
         return -1;
     }
+    stream->demux_started = 1;
 
-    // decode frames one by one
-    av_init_packet(&pkt);
+    return 0;
+}
+
+static void close_stream(PlayerStream *stream)
+{
+    if (stream->packet_queue) {
+        // unblock demux in case decoding stopped before the end of stream
+        queue_abort(stream->packet_queue);
+        if (stream->demux_started)
+            pthread_join(stream->demux_thread_id, NULL);
+        queue_destroy(stream->packet_queue, free_packet);
+        stream->packet_queue = NULL;
+    }
+
+    pthread_mutex_lock(&open_mutex);
+    if (stream->opened)
+        avcodec_close(stream->video_dec_ctx);
+    if (stream->format_ctx)
+        avformat_close_input(&stream->format_ctx);
+    pthread_mutex_unlock(&open_mutex);
+    input_reader_close(stream->input_reader);
+    stream->input_reader = NULL;
+    stream->opened = 0;
+}
+
+static int push_frame(PlayerContext *player, PlayerStream *stream, AVFrame *frame, FrameTiming *timing,
+    int seek_index, int64_t seek_start)
+{
+    PlayerFrame *item = av_mallocz(sizeof(PlayerFrame));
+
+    if (!item)
+        return -1;
+    item->frame = frame;
+    item->stream = stream;
+    item->timing = timing;
+    item->seek_index = seek_index;
+    item->seek_start = seek_start;
+    if (queue_push(player->frame_queue, item) < 0) {
+        item->frame = NULL; // still owned by the caller
+        free_player_frame(item);
+        return -1;
+    }
+
+    return 0;
+}
+
+// a decoded frame goes to the frame queue unless it precedes the seek target; return 1 if the queue
+// owns it now, 0 if it was dropped (and unref'ed), -1 on error
+static int output_frame(PlayerContext *player, PlayerStream *stream, AVFrame *frame,
+    int *seek_index, int64_t seek_target, int64_t seek_start)
+{
+    FrameTiming *timing = NULL;
+    int64_t pts = frame->pkt_pts != AV_NOPTS_VALUE ? frame->pkt_pts : frame->pts;
+
+    stream->decode_stats.count++;
+    if (player->track_latency)
+        timing = latency_output(&stream->latency, pts);
+    if (*seek_index >= 0 && pts != AV_NOPTS_VALUE && pts < seek_target) {
+        // decoded from the key frame before the seek target, not shown
+        av_free(timing);
+        av_frame_unref(frame);
+        return 0;
+    }
+    if (push_frame(player, stream, frame, timing, *seek_index, seek_start) < 0) {
+        av_free(timing);
+        return -1;
+    }
+    *seek_index = -1;
+
+    return 1;
+}
+
+static void decode_stream(PlayerContext *player, PlayerStream *stream)
+{
+    PlayerPacket *pkt = NULL;
+    AVFrame *frame = NULL;
+    int ret;
+    int seek_index = -1;            // waiting for the first frame at or after seek_target
+    int64_t seek_target = 0, seek_start = 0;
+    int64_t t;
+#if LIBAVCODEC_VERSION_INT < AV_VERSION_INT(57, 37, 100)
+    AVPacket flush_pkt;
+    int got_picture;
+
+    av_init_packet(&flush_pkt);
+    flush_pkt.data = NULL;
+    flush_pkt.size = 0;
+#endif
+
+    stage_begin(&stream->decode_stats, "decode");
     while (1) {
-        if(read_eos == 0 && av_read_frame(pFormat, &pkt) < 0) {
-            read_eos = 1;
+        // NULL packet: end of stream, drain the frames delayed in decoder
+        pkt = queue_pop(stream->packet_queue);
+        if (pkt && pkt->seek_index >= 0) {
+            // frames of the old position are dropped, the decoder keeps its surfaces
+            t = av_gettime();
+            avcodec_flush_buffers(stream->video_dec_ctx);
+            stream->decode_stats.busy_time += av_gettime() - t;
+            seek_index = pkt->seek_index;
+            seek_target = pkt->seek_target;
+            seek_start = pkt->seek_start;
+            free_packet(pkt);
+            continue;
         }
-        if (read_eos) {
-            pkt.data = NULL;
-            pkt.size = 0;
+
+        // the sink asks to skip non-ref frames when it falls behind
+        stream->video_dec_ctx->skip_frame = scheduler_get_skip_frame(&stream->scheduler);
+        if (player->track_latency && pkt)
+            latency_submit(&stream->latency, pkt->pkt.pts, pkt->demux_time);
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(57, 37, 100)
+        // the decoder may buffer several packets before the first frame, and return several frames
+        // for one packet: all frames ready by now are taken, then the next packet is sent
+        t = av_gettime();
+        ret = avcodec_send_packet(stream->video_dec_ctx, pkt ? &pkt->pkt : NULL);
+        stream->decode_stats.busy_time += av_gettime() - t;
+        if (pkt)
+            free_packet(pkt);
+        if (ret < 0) { // decode fail, frames are only pulled after a packet was accepted
+            DEBUG("send packet ret=%d, exit ...\n", ret);
+            break;
         }
 
-        if (pkt.stream_index == video_stream_index) {
-            frame = av_frame_alloc();
-            int got_picture = 0,ret = 0;
-            ret = avcodec_decode_video2(video_dec_ctx, frame, &got_picture, &pkt);
-            if (ret < 0) { // decode fail (or decode finished)
-                DEBUG("exit ...\n");
+        do {
+            if (!frame)
+                frame = av_frame_alloc();
+            if (!frame) {
+                ret = AVERROR(ENOMEM);
                 break;
             }
+            t = av_gettime();
+            ret = avcodec_receive_frame(stream->video_dec_ctx, frame);
+            stream->decode_stats.busy_time += av_gettime() - t;
+            if (ret == 0 && (ret = output_frame(player, stream, frame, &seek_index, seek_target, seek_start)) > 0)
+                frame = NULL; // owned by the frame queue now
+        } while (ret >= 0);
+        if (ret != AVERROR(EAGAIN)) { // decode fail, or eos has been processed
+            DEBUG("receive frame ret=%d, exit ...\n", ret);
+            break;
+        }
+#else
+        if (!frame)
+            frame = av_frame_alloc();
+        if (!frame)
+            break;
 
-            if (read_eos && ret>=0 && !got_picture) {
-                DEBUG("ret=%d, exit ...\n", ret);
-                break; // eos has been processed
-            }
+        t = av_gettime();
+        got_picture = 0;
+        ret = avcodec_decode_video2(stream->video_dec_ctx, frame, &got_picture, pkt ? &pkt->pkt : &flush_pkt);
+        stream->decode_stats.busy_time += av_gettime() - t;
+        if (pkt)
+            free_packet(pkt);
 
-            decode_count++;
-            if (got_picture) {
-                switch (render_mode) {
-                case 0: // dump raw video frame to disk file
-                case 1: { // draw raw frame data as texture
-                    // assumed I420 format
-                    int height[3] = {video_dec_ctx->height, video_dec_ctx->height/2, video_dec_ctx->height/2};
-                    int width[3] = {video_dec_ctx->width, video_dec_ctx->width/2, video_dec_ctx->width/2};
-                    int plane, row;
-
-                    if (render_mode == 0) {
-                        if (!dump_yuv) {
-                            char out_file[256];
-                            sprintf(out_file, "./dump_%dx%d.I420", video_dec_ctx->width, video_dec_ctx->height);
-                            dump_yuv = fopen(out_file, "ab");
-                            if (!dump_yuv) {
-                                ERROR("fail to create file for dumped yuv data\n");
-                                return -1;
-                            }
-                        }
-                        for (plane=0; plane<3; plane++) {
-                            for (row = 0; row<height[plane]; row++)
-                                fwrite(frame->data[plane]+ row*frame->linesize[plane], width[plane], 1, dump_yuv);
-                        }
-                    } else {
-                        // glTexImage2D  doesn't handle pitch, make a copy of video data
-                        frame_copy = malloc(video_dec_ctx->height * video_dec_ctx->width * 3 / 2);
-                        unsigned char* ptr = frame_copy;
-
-                        for (plane=0; plane<3; plane++) {
-                            for (row=0; row<height[plane]; row++) {
-                                memcpy(ptr, frame->data[plane]+row*frame->linesize[plane], width[plane]);
-                                ptr += width[plane];
-                            }
-                        }
-
-                        drawVideo((uintptr_t)frame_copy, 0, video_dec_ctx->width, video_dec_ctx->height, 0);
-                    }
-                }
-                    break;
-                case 2: // draw video frame as texture with drm handle
-                case 3: // draw video frame as texture with dma_buf handle
-                    drawVideo((uintptr_t)frame->data[0], render_mode -1, video_dec_ctx->width, video_dec_ctx->height, (uintptr_t)frame->data[1]);
-                    break;
-                default:
-                    break;
-                }
-                render_count++;
-            }
+        if (ret < 0) { // decode fail (or decode finished)
+            DEBUG("exit ...\n");
+            break;
+        }
+        if (!pkt && !got_picture) {
+            DEBUG("ret=%d, exit ...\n", ret);
+            break; // eos has been processed
+        }
+
+        if (got_picture) {
+            ret = output_frame(player, stream, frame, &seek_index, seek_target, seek_start);
+            if (ret < 0)
+                break;
+            if (ret > 0)
+                frame = NULL; // owned by the frame queue now
         }
+#endif
     }
 
     if (frame)
         av_frame_free(&frame);
-    if (frame_copy)
-        free(frame_copy);
-    if (dump_yuv)
-        fclose(dump_yuv);
-    deinit_egl();
-    PRINTF("decode %s ok, decode_count=%d, render_count=%d\n", input_file, decode_count, render_count);
+    stage_end(&stream->decode_stats);
+}
+
+static void* worker_thread(void *arg)
+{
+    PlayerContext *player = (PlayerContext*)arg;
+    PlayerStream *stream;
+    int index;
+
+    while ((index = __atomic_fetch_add(&player->next_stream, 1, __ATOMIC_RELAXED)) < player->stream_count) {
+        stream = &player->streams[index];
+        if (open_stream(player, stream) == 0) {
+            decode_stream(player, stream);
+
+            // frames still queued or held by the sink reference decoder surfaces, wait for the sink
+            // to release them before closing the decoder. without the end marker (aborted queue, no
+            // memory) only the sink exit tells that, it may still be rendering or flushing
+            if (push_frame(player, stream, NULL, NULL, -1, 0) < 0)
+                queue_abort(player->frame_queue);
+            pthread_mutex_lock(&player->sink_mutex);
+            while (!stream->sink_done && !player->sink_exited)
+                pthread_cond_wait(&player->sink_cond, &player->sink_mutex);
+            pthread_mutex_unlock(&player->sink_mutex);
+        }
+        close_stream(stream);
+    }
+
+    if (__atomic_sub_fetch(&player->active_workers, 1, __ATOMIC_ACQ_REL) == 0)
+        queue_finish(player->frame_queue);
+
+    return NULL;
+}
+
+// thumbnail sink: called by the renderer for each size of each frame read back, in order
+static void write_thumbnail(void *opaque, void *tag, int index, const uint8_t *rgb, int width, int height)
+{
+    PlayerStream *stream = tag;
+    char file_name[1024];
+    FILE *fp;
+
+    if (!index)
+        stream->thumbnail_count++;
+    if (!dump_file)
+        return;
+    if (thumbnail_size_count > 1)
+        snprintf(file_name, sizeof(file_name), "%s_%d_%d_%dx%d.ppm", dump_file, stream->index,
+            stream->thumbnail_count - 1, width, height);
+    else
+        snprintf(file_name, sizeof(file_name), "%s_%d_%d.ppm", dump_file, stream->index, stream->thumbnail_count - 1);
+    fp = fopen(file_name, "wb");
+    if (!fp) {
+        ERROR("fail to create thumbnail file: %s\n", file_name);
+        return;
+    }
+    fprintf(fp, "P6\n%d %d\n255\n", width, height);
+    fwrite(rgb, 1, width * height * 3, fp);
+    fclose(fp);
+}
+
+// on the sink thread: the size comes with the frame, the decoder context belongs to the worker and
+// changes with the resolution while older frames are still queued
+static int render_frame(PlayerContext *player, PlayerFrame *item)
+{
+    PlayerStream *stream = item->stream;
+    AVFrame *frame = item->frame;
+
+    switch (render_mode) {
+    case 0: // dump raw video frame to disk file
+        if (!stream->dump_writer) {
+            stream->dump_writer = dump_writer_create(dump_file, player->stream_count > 1 ? stream->index : -1,
+                stream->format_ctx->streams[stream->video_stream_index]->avg_frame_rate);
+            if (!stream->dump_writer)
+                return -1;
+        }
+        // the writer thread keeps a reference of the frame
+        return dump_writer_write(stream->dump_writer, frame);
+    case 1: { // draw raw frame data as texture
+        // the renderer handles pitch (and keeps the textures), yuv->rgb is done by shader
+        uint32_t pitches[3] = {frame->linesize[0], frame->linesize[1], frame->linesize[2]};
+        int bt709 = frame->colorspace == AVCOL_SPC_BT709 ||
+            (frame->colorspace == AVCOL_SPC_UNSPECIFIED && frame->height >= 720);
+
+        setVideoColorSpace(bt709, frame->color_range == AVCOL_RANGE_JPEG);
+        if (mosaic)
+            return drawVideoTileRaw(stream->index % (mosaic_cols * mosaic_rows), frame->data, pitches,
+                frame->format == AV_PIX_FMT_NV12 ? YUV_FOURCC_NV12 : YUV_FOURCC_I420,
+                frame->width, frame->height);
+        drawVideoRaw(frame->data, pitches, frame->format == AV_PIX_FMT_NV12 ? YUV_FOURCC_NV12 : YUV_FOURCC_I420,
+            frame->width, frame->height);
+    }
+        break;
+    case 2: // draw video frame as texture with drm handle
+    case 3: // draw video frame as texture with dma_buf handle
+        setVideoStream(stream->index);
+        if (mosaic)
+            return drawVideoTile(stream->index % (mosaic_cols * mosaic_rows), (uintptr_t)frame->data[0], render_mode - 1,
+                frame->width, frame->height, (uintptr_t)frame->data[1]);
+        drawVideo((uintptr_t)frame->data[0], render_mode -1, frame->width, frame->height, (uintptr_t)frame->data[1]);
+        break;
+    case 5: { // thumbnail: scale into an fbo and read back
+        uint32_t pitches[3] = {frame->linesize[0], frame->linesize[1], frame->linesize[2]};
+        int bt709 = frame->colorspace == AVCOL_SPC_BT709 ||
+            (frame->colorspace == AVCOL_SPC_UNSPECIFIED && frame->height >= 720);
+
+        if (stream->thumbnail_frames++ % thumbnail_interval)
+            break;
+        setVideoColorSpace(bt709, frame->color_range == AVCOL_RANGE_JPEG);
+        return readbackVideoRaw(frame->data, pitches, frame->format == AV_PIX_FMT_NV12 ? YUV_FOURCC_NV12 : YUV_FOURCC_I420,
+            frame->width, frame->height, stream);
+    }
+    case 4: // null sink, the frame is released by caller
+        if (player->track_latency) {
+            latency_sink(&stream->latency, item->timing);
+            item->timing = NULL;
+        }
+        break;
+    default:
+        break;
+    }
 
     return 0;
 }
 
+// release everything of the session held by the sink, then let its worker close the decoder
+static void finish_stream_sink(PlayerContext *player, PlayerStream *stream)
+{
+    if (stream->dump_writer) {
+        dump_writer_close(stream->dump_writer);
+        stream->dump_writer = NULL;
+    }
+    // cached EGLImages reference the decoder surfaces, the other streams keep theirs
+    flushVideoImageCache(stream->index);
+    flushVideoReadback();
+    if (render_mode == 5)
+        PRINTF("stream %d: %d thumbnails\n", stream->index, stream->thumbnail_count);
+    stage_end(&stream->sink_stats);
+
+    pthread_mutex_lock(&player->sink_mutex);
+    stream->sink_done = 1;
+    pthread_cond_broadcast(&player->sink_cond);
+    pthread_mutex_unlock(&player->sink_mutex);
+}
+
+static void run_sink(PlayerContext *player)
+{
+    PlayerFrame *item;
+    PlayerStream *stream;
+    int64_t t, last_present = 0;
+    int i;
+
+    // render frames on the main thread, EGL/X11 are set up here
+    stage_begin(&player->sink_stats, "sink");
+    while ((item = queue_pop(player->frame_queue))) {
+        stream = item->stream;
+        if (!item->frame) {
+            finish_stream_sink(player, stream);
+            free_player_frame(item);
+            continue;
+        }
+
+        if (item->seek_index >= 0) {
+            SeekResult *result = &stream->seeks[item->seek_index];
+            result->first_pts = item->frame->pkt_pts != AV_NOPTS_VALUE ? item->frame->pkt_pts : item->frame->pts;
+            scheduler_reset(&stream->scheduler);
+        }
+
+        // late frames are dropped before upload/import
+        if (!scheduler_wait(&stream->scheduler, item->frame)) {
+            free_player_frame(item);
+            continue;
+        }
+        t = av_gettime();
+        if (render_frame(player, item) < 0) {
+            free_player_frame(item);
+            queue_abort(player->frame_queue);
+            break;
+        }
+        // tiles are updated as their frames arrive, the wall is shown at most once per refresh
+        if (mosaic && t - last_present >= MOSAIC_REFRESH_US) {
+            presentVideoMosaic();
+            last_present = t;
+        }
+        scheduler_presented(&stream->scheduler);
+        if (!stream->startup.first_frame)
+            stream->startup.first_frame = av_gettime();
+        if (item->seek_index >= 0) {
+            stream->seeks[item->seek_index].latency = av_gettime() - item->seek_start;
+            __atomic_store_n(&stream->seek_done, item->seek_index, __ATOMIC_RELEASE);
+        }
+        free_player_frame(item);
+        t = av_gettime() - t;
+        stream->sink_stats.busy_time += t;
+        stream->sink_stats.count++;
+        player->sink_stats.busy_time += t;
+        player->sink_stats.count++;
+    }
+    if (mosaic)
+        presentVideoMosaic();
+    stage_end(&player->sink_stats);
+
+    // after an abort, release what the sink still holds before the workers close their decoders
+    queue_flush(player->frame_queue, free_player_frame);
+    for (i = 0; i < player->stream_count; i++) {
+        if (player->streams[i].dump_writer) {
+            dump_writer_close(player->streams[i].dump_writer);
+            player->streams[i].dump_writer = NULL;
+        }
+    }
+    flushVideoImageCache(-1);
+    flushVideoReadback();
+    pthread_mutex_lock(&player->sink_mutex);
+    player->sink_exited = 1;
+    pthread_cond_broadcast(&player->sink_cond);
+    pthread_mutex_unlock(&player->sink_mutex);
+}
+
+static void print_seek_stats(PlayerStream *stream)
+{
+    AVRational time_base = stream->time_base;
+    int64_t sum = 0, max = 0;
+    int i, reached = 0;
+
+    for (i = 0; i < seek_count; i++) {
+        SeekResult *result = &stream->seeks[i];
+        if (result->latency < 0) {
+            PRINTF("seek %d: %.3f s, first frame not reached\n", i, seek_times[i]);
+            continue;
+        }
+        PRINTF("seek %d: %.3f s, first frame at %.3f s, latency %.2f ms\n", i, seek_times[i],
+            result->first_pts != AV_NOPTS_VALUE ? result->first_pts * av_q2d(time_base) : -1.0, result->latency / 1000.0);
+        sum += result->latency;
+        if (result->latency > max)
+            max = result->latency;
+        reached++;
+    }
+    PRINTF("seek: %d of %d reached, latency average %.2f ms max %.2f ms\n", reached, seek_count,
+        reached ? sum / 1000.0 / reached : 0.0, max / 1000.0);
+}
+
+static void print_startup_stats(StartupTiming *startup)
+{
+    if (!startup->first_frame)
+        return;
+    PRINTF("startup: time to first frame %.2f ms (wait %.2f, open %.2f, probe %.2f, codec %.2f, first packet %.2f, first frame %.2f)\n",
+        (startup->first_frame - startup->open_start) / 1000.0, (startup->open_locked - startup->open_start) / 1000.0,
+        (startup->input_opened - startup->open_locked) / 1000.0, (startup->info_found - startup->input_opened) / 1000.0,
+        (startup->codec_opened - startup->info_found) / 1000.0, (startup->first_packet - startup->codec_opened) / 1000.0,
+        (startup->first_frame - startup->first_packet) / 1000.0);
+}
+
+static void print_json_report(PlayerContext *player)
+{
+    FILE *fp = json_file ? fopen(json_file, "w") : stdout;
+    int64_t elapsed = player->sink_stats.end_time - player->sink_stats.start_time;
+    int i;
 
+    if (!fp) {
+        ERROR("fail to create json report file: %s\n", json_file);
+        return;
+    }
+
+    if (player->stream_count == 1)
+        latency_print_json(&player->streams[0].latency, fp, player->streams[0].input_file, &player->streams[0].startup);
+    else {
+        fprintf(fp, "{\"frames\": %d, \"fps\": %.2f, \"streams\": [", player->sink_stats.count,
+            elapsed > 0 ? player->sink_stats.count * 1000000.0 / elapsed : 0.0);
+        for (i = 0; i < player->stream_count; i++) {
+            if (i)
+                fprintf(fp, ", ");
+            latency_print_json(&player->streams[i].latency, fp, player->streams[i].input_file, &player->streams[i].startup);
+        }
+        fprintf(fp, "]}");
+    }
+    fprintf(fp, "\n");
+    if (fp != stdout)
+        fclose(fp);
+    else
+        fflush(fp);
+}
+
+int main(int argc, char *argv[])
+{
+    PlayerContext player;
+    PlayerStream *stream;
+    int i;
+    int64_t start_time = av_gettime();
+
+    // parse command line parameters
+    if (process_cmdline(argc, argv) < 0)
+        return -1;
+    if (!input_count) {
+        ERROR("no input file specified\n");
+        return -1;
+    }
+    if (mosaic && (render_mode < 1 || render_mode > 3 ||
+        setVideoMosaic(mosaic_cols, mosaic_rows, mosaic_width, mosaic_height) < 0)) {
+        ERROR("render mode %d can't show a %dx%d video wall\n", render_mode, mosaic_cols, mosaic_rows);
+        return -1;
+    }
+
+    memset(&player, 0, sizeof(player));
+    player.stream_count = input_count;
+    player.streams = av_mallocz(input_count * sizeof(PlayerStream));
+    player.worker_count = worker_count;
+    player.worker_thread_ids = av_mallocz(worker_count * sizeof(pthread_t));
+    player.frame_queue = queue_create(FRAME_QUEUE_SIZE);
+    ASSERT(player.streams && player.worker_thread_ids && player.frame_queue);
+    player.track_latency = render_mode == 4;
+    setVideoDrawOptions(draw_fit, swap_interval, triple_buffer);
+    setVideoOffscreen(offscreen || render_mode == 5);
+    if (render_mode == 5)
+        setVideoReadback(thumbnail_sizes, thumbnail_size_count, write_thumbnail, &player);
+    pthread_mutex_init(&player.sink_mutex, NULL);
+    pthread_cond_init(&player.sink_cond, NULL);
+    for (i = 0; i < input_count; i++) {
+        stream = &player.streams[i];
+        stream->index = i;
+        stream->input_file = input_files[i];
+        stream->video_stream_index = -1;
+        if (player.track_latency)
+            latency_init(&stream->latency, start_time);
+    }
+
+    // libav* init
+    av_register_all();
+
+    // each worker runs demux/decode sessions one after another
+    player.active_workers = worker_count;
+    for (i = 0; i < worker_count; i++) {
+        if (pthread_create(&player.worker_thread_ids[i], NULL, worker_thread, &player)) {
+            ERROR("fail to create worker thread\n");
+            return -1;
+        }
+    }
+
+    // the display, EGL context and shaders come up while the workers probe their inputs and open the decoders
+    if ((render_mode >= 1 && render_mode <= 3) || render_mode == 5)
+        prepareVideoRender(render_mode == 5 ? 0 : render_mode - 1, YUV_FOURCC_I420);
+    run_sink(&player);
+
+    for (i = 0; i < worker_count; i++)
+        pthread_join(player.worker_thread_ids[i], NULL);
+    queue_print_stats(player.frame_queue, "frame");
+    queue_destroy(player.frame_queue, free_player_frame);
+    deinit_egl();
+
+    for (i = 0; i < player.stream_count; i++) {
+        stream = &player.streams[i];
+        if (!stream->demux_stats.name) {
+            PRINTF("decode %s failed\n", stream->input_file);
+            continue;
+        }
+        PRINTF("decode %s ok, decode_count=%d, render_count=%d\n", stream->input_file, stream->decode_stats.count, stream->sink_stats.count);
+        print_stage_stats(&stream->demux_stats);
+        print_stage_stats(&stream->decode_stats);
+        print_stage_stats(&stream->sink_stats);
+        print_startup_stats(&stream->startup);
+        scheduler_print_stats(&stream->scheduler);
+        if (seek_count)
+            print_seek_stats(stream);
+    }
+    if (player.stream_count > 1) {
+        PRINTF("aggregate of %d streams:\n", player.stream_count);
+        print_stage_stats(&player.sink_stats);
+    }
+    if (player.track_latency) {
+        print_json_report(&player);
+        for (i = 0; i < player.stream_count; i++)
+            latency_release(&player.streams[i].latency);
+    }
+
+    pthread_mutex_destroy(&player.sink_mutex);
+    pthread_cond_destroy(&player.sink_cond);
+    av_free(player.worker_thread_ids);
+    av_free(player.streams);
+
+    return 0;
+}
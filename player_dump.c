@@ -0,0 +1,297 @@
+/*
+ *  player_dump.c - asynchronous raw/y4m video frame dump
+ *
+ *  Copyright (C) 2015 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/uio.h>
+#include <libavutil/time.h>
+#include "player_dump.h"
+#include "player_queue.h"
+#include "player_log.h"
+
+#define DUMP_QUEUE_SIZE 4       // queued frames keep decoder buffers alive, don't starve the decoder
+#define DUMP_IOV_MAX    1024    // UIO_MAXIOV on linux
+
+static const char Y4M_FRAME_HEADER[] = "FRAME\n";
+
+struct DumpWriter {
+    char *file_name;
+    int index;
+    int y4m;
+    AVRational frame_rate;
+
+    int fd;
+    int width;
+    int height;
+    int format;
+
+    PlayerQueue *queue;
+    pthread_t thread_id;
+    int error;                  // set by the writer thread
+
+    struct iovec iov[DUMP_IOV_MAX];
+    int iov_count;
+
+    // statistics
+    int frames;
+    int64_t bytes;
+    int64_t write_time;
+    int write_calls;
+};
+
+static int has_suffix(const char *str, const char *suffix)
+{
+    size_t len = strlen(str), suffix_len = strlen(suffix);
+
+    return len >= suffix_len && !strcasecmp(str + len - suffix_len, suffix);
+}
+
+static int flush_iov(DumpWriter *writer)
+{
+    struct iovec *iov = writer->iov;
+    int count = writer->iov_count;
+    int64_t t = av_gettime();
+    ssize_t written;
+
+    while (count) {
+        written = writev(writer->fd, iov, count > DUMP_IOV_MAX ? DUMP_IOV_MAX : count);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            ERROR("fail to write dump file: %s\n", strerror(errno));
+            return -1;
+        }
+        writer->write_calls++;
+        writer->bytes += written;
+
+        // skip what has been written, partial writes end in the middle of an iovec
+        while (count && (size_t)written >= iov->iov_len) {
+            written -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count) {
+            iov->iov_base = (uint8_t*)iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+    writer->iov_count = 0;
+    writer->write_time += av_gettime() - t;
+
+    return 0;
+}
+
+static int add_iov(DumpWriter *writer, const void *data, size_t size)
+{
+    if (writer->iov_count == DUMP_IOV_MAX && flush_iov(writer) < 0)
+        return -1;
+    writer->iov[writer->iov_count].iov_base = (void*)data;
+    writer->iov[writer->iov_count].iov_len = size;
+    writer->iov_count++;
+
+    return 0;
+}
+
+static int open_dump_file(DumpWriter *writer, AVFrame *frame)
+{
+    char out_file[256];
+    const char *name = writer->file_name;
+    char header[128];
+    int len;
+
+    writer->width = frame->width;
+    writer->height = frame->height;
+    writer->format = frame->format;
+    if (!name) {
+        char stream_tag[16] = "";
+        if (writer->index >= 0)
+            snprintf(stream_tag, sizeof(stream_tag), "%d_", writer->index);
+        snprintf(out_file, sizeof(out_file), "./dump_%s%dx%d.%s", stream_tag, frame->width, frame->height,
+            frame->format == AV_PIX_FMT_NV12 ? "NV12" : "I420");
+        name = out_file;
+    } else if (writer->index >= 0) {
+        // insert the stream index before the extension: out.y4m --> out_1.y4m
+        const char *ext = strrchr(name, '.');
+        int base_len = ext && !strchr(ext, '/') ? (int)(ext - name) : (int)strlen(name);
+        snprintf(out_file, sizeof(out_file), "%.*s_%d%s", base_len, name, writer->index, name + base_len);
+        name = out_file;
+    }
+
+    writer->fd = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (writer->fd < 0) {
+        ERROR("fail to create file for dumped yuv data: %s\n", name);
+        return -1;
+    }
+    PRINTF("dump video frames to %s\n", name);
+
+    if (writer->y4m) {
+        if (frame->format == AV_PIX_FMT_NV12) {
+            ERROR("y4m dump supports I420 only\n");
+            return -1;
+        }
+        // decoded 4:2:0 video (h264, hevc, mpeg2) has mpeg2 chroma siting, left aligned between the rows
+        len = snprintf(header, sizeof(header), "YUV4MPEG2 W%d H%d F%d:%d Ip A0:0 C420mpeg2\n",
+            frame->width, frame->height, writer->frame_rate.num, writer->frame_rate.den);
+        if (add_iov(writer, header, len) < 0 || flush_iov(writer) < 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+static int dump_frame(DumpWriter *writer, AVFrame *frame)
+{
+    int plane_count = frame->format == AV_PIX_FMT_NV12 ? 2 : 3;
+    int chroma_width = (frame->width + 1) / 2;
+    int chroma_height = (frame->height + 1) / 2;
+    int plane, row, row_bytes, rows;
+
+    if (writer->fd < 0 && open_dump_file(writer, frame) < 0)
+        return -1;
+    if (frame->width != writer->width || frame->height != writer->height || frame->format != writer->format) {
+        if (writer->y4m) {
+            ERROR("y4m dump doesn't support resolution change: %dx%d --> %dx%d\n",
+                writer->width, writer->height, frame->width, frame->height);
+            return -1;
+        }
+        DEBUG("resolution change in raw dump: %dx%d --> %dx%d\n", writer->width, writer->height, frame->width, frame->height);
+        writer->width = frame->width;
+        writer->height = frame->height;
+        writer->format = frame->format;
+    }
+
+    if (writer->y4m && add_iov(writer, Y4M_FRAME_HEADER, sizeof(Y4M_FRAME_HEADER) - 1) < 0)
+        return -1;
+
+    // one iovec per plane if the rows are contiguous, per row otherwise; one writev per frame
+    for (plane = 0; plane < plane_count; plane++) {
+        row_bytes = !plane ? frame->width : (plane_count == 2 ? chroma_width * 2 : chroma_width);
+        rows = !plane ? frame->height : chroma_height;
+        if (frame->linesize[plane] == row_bytes) {
+            if (add_iov(writer, frame->data[plane], (size_t)row_bytes * rows) < 0)
+                return -1;
+            continue;
+        }
+        for (row = 0; row < rows; row++) {
+            if (add_iov(writer, frame->data[plane] + row * frame->linesize[plane], row_bytes) < 0)
+                return -1;
+        }
+    }
+    if (flush_iov(writer) < 0)
+        return -1;
+    writer->frames++;
+
+    return 0;
+}
+
+static void* dump_thread(void *arg)
+{
+    DumpWriter *writer = (DumpWriter*)arg;
+    AVFrame *frame;
+
+    while ((frame = queue_pop(writer->queue))) {
+        if (dump_frame(writer, frame) < 0) {
+            __atomic_store_n(&writer->error, 1, __ATOMIC_RELAXED);
+            queue_abort(writer->queue);
+        }
+        av_frame_free(&frame);
+    }
+
+    return NULL;
+}
+
+static void free_frame(void *item)
+{
+    AVFrame *frame = (AVFrame*)item;
+
+    av_frame_free(&frame);
+}
+
+DumpWriter* dump_writer_create(const char *file_name, int index, AVRational frame_rate)
+{
+    DumpWriter *writer = av_mallocz(sizeof(DumpWriter));
+
+    if (!writer)
+        return NULL;
+
+    writer->fd = -1;
+    writer->index = index;
+    writer->y4m = file_name && has_suffix(file_name, ".y4m");
+    writer->frame_rate = frame_rate;
+    if (writer->frame_rate.num <= 0 || writer->frame_rate.den <= 0)
+        writer->frame_rate = (AVRational){25, 1};
+    if (file_name)
+        writer->file_name = strdup(file_name);
+    writer->queue = queue_create(DUMP_QUEUE_SIZE);
+    if (!writer->queue || pthread_create(&writer->thread_id, NULL, dump_thread, writer)) {
+        ERROR("fail to create dump writer thread\n");
+        queue_destroy(writer->queue, NULL);
+        free(writer->file_name);
+        av_free(writer);
+        return NULL;
+    }
+
+    return writer;
+}
+
+int dump_writer_write(DumpWriter *writer, AVFrame *frame)
+{
+    AVFrame *ref;
+
+    if (__atomic_load_n(&writer->error, __ATOMIC_RELAXED))
+        return -1;
+
+    // the caller releases its frame right away, the writer keeps its own reference
+    ref = av_frame_clone(frame);
+    if (!ref)
+        return -1;
+    ref->opaque = NULL;
+    if (queue_push(writer->queue, ref) < 0) {
+        av_frame_free(&ref);
+        return -1;
+    }
+
+    return 0;
+}
+
+void dump_writer_close(DumpWriter *writer)
+{
+    if (!writer)
+        return;
+
+    queue_finish(writer->queue);
+    pthread_join(writer->thread_id, NULL);
+    queue_print_stats(writer->queue, "dump");
+    queue_destroy(writer->queue, free_frame);
+    if (writer->fd >= 0)
+        close(writer->fd);
+
+    PRINTF("dump: %d frames, %.2f MB, %d writev calls, %.2f ms in write, %.2f MB/s\n", writer->frames,
+        writer->bytes / 1048576.0, writer->write_calls, writer->write_time / 1000.0,
+        writer->write_time ? writer->bytes / 1.048576 / writer->write_time : 0.0);
+    free(writer->file_name);
+    av_free(writer);
+}
@@ -0,0 +1,37 @@
+/*
+ *  player_dump.h - asynchronous raw/y4m video frame dump
+ *
+ *  Copyright (C) 2015 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef __PLAYER_DUMP_H__
+#define __PLAYER_DUMP_H__
+
+#include <libavutil/frame.h>
+
+typedef struct DumpWriter DumpWriter;
+
+// file_name NULL: ./dump_<width>x<height>.<I420|NV12>, a file name ending with .y4m selects y4m output
+// index >= 0 adds _<index> to the file name, for multiple streams in one process
+DumpWriter* dump_writer_create(const char *file_name, int index, AVRational frame_rate);
+// queue a reference of the frame for writing, return -1 if the writer failed
+int dump_writer_write(DumpWriter *writer, AVFrame *frame);
+// write out the queued frames and close the file
+void dump_writer_close(DumpWriter *writer);
+
+#endif // __PLAYER_DUMP_H__
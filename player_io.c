@@ -0,0 +1,323 @@
+/*
+ *  player_io.c - mmap / read-ahead input for avformat
+ *
+ *  Copyright (C) 2015 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <libavutil/mem.h>
+#include <libavutil/error.h>
+#include <libavutil/time.h>
+#include "player_io.h"
+#include "player_log.h"
+
+struct InputReader {
+    char *file_name;
+    int fd;
+    int buffer_size;
+    AVIOContext *avio;
+    int64_t pos;                // next byte returned to avformat
+
+    // regular file
+    uint8_t *map;
+    int64_t size;
+    int64_t advised;            // [pos, advised) has been given to MADV_WILLNEED
+
+    // pipe/socket: the thread fills [pos, write_total) of the ring
+    uint8_t *ring;
+    int ring_size;
+    int64_t write_total;
+    int eof;
+    int error;
+    int aborted;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    pthread_t thread_id;
+    int thread_started;
+
+    // statistics
+    int64_t open_time;
+    int64_t bytes;
+    int64_t stall_time;         // avformat waited for the ring, or for page faults of the mapping
+    int syscalls;
+};
+
+// the kernel reads the next window in the background while avformat consumes this one
+static void advise_read_ahead(InputReader *reader)
+{
+    int64_t window = (int64_t)reader->buffer_size * INPUT_READ_AHEAD_BUFFERS;
+    int64_t page_mask = sysconf(_SC_PAGESIZE) - 1;
+    int64_t start, end;
+
+    if (reader->advised >= reader->size || reader->pos + window / 2 < reader->advised)
+        return;
+    start = (reader->advised > reader->pos ? reader->advised : reader->pos) & ~page_mask;
+    end = reader->pos + window < reader->size ? reader->pos + window : reader->size;
+    madvise(reader->map + start, end - start, MADV_WILLNEED);
+    reader->syscalls++;
+    reader->advised = end;
+}
+
+static int read_mapped(void *opaque, uint8_t *buf, int buf_size)
+{
+    InputReader *reader = (InputReader*)opaque;
+    int64_t t;
+    int size;
+
+    if (reader->pos >= reader->size)
+        return AVERROR_EOF;
+    size = reader->size - reader->pos < buf_size ? (int)(reader->size - reader->pos) : buf_size;
+    advise_read_ahead(reader);
+
+    // page faults of the pages not read ahead yet block here
+    t = av_gettime();
+    memcpy(buf, reader->map + reader->pos, size);
+    reader->stall_time += av_gettime() - t;
+    reader->pos += size;
+    reader->bytes += size;
+
+    return size;
+}
+
+static int64_t seek_mapped(void *opaque, int64_t offset, int whence)
+{
+    InputReader *reader = (InputReader*)opaque;
+    int64_t pos;
+
+    switch (whence & ~AVSEEK_FORCE) {
+    case AVSEEK_SIZE:
+        return reader->size;
+    case SEEK_SET:
+        pos = offset;
+        break;
+    case SEEK_CUR:
+        pos = reader->pos + offset;
+        break;
+    case SEEK_END:
+        pos = reader->size + offset;
+        break;
+    default:
+        return AVERROR(EINVAL);
+    }
+    if (pos < 0 || pos > reader->size)
+        return AVERROR(EINVAL);
+    reader->pos = pos;
+    reader->advised = pos;
+
+    return pos;
+}
+
+static void* read_ahead_thread(void *arg)
+{
+    InputReader *reader = (InputReader*)arg;
+    int64_t read_total;
+    int offset, size;
+    ssize_t n;
+
+    // only a read() blocked on an idle pipe is cancelled, never a wait holding the mutex
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+    pthread_mutex_lock(&reader->mutex);
+    while (!reader->aborted && !reader->eof && !reader->error) {
+        read_total = reader->pos;
+        if (reader->write_total - read_total == reader->ring_size) {
+            pthread_cond_wait(&reader->cond, &reader->mutex);
+            continue;
+        }
+        // one read() into the free space up to the end of the ring, avformat only reads the filled part
+        offset = reader->write_total % reader->ring_size;
+        size = reader->ring_size - (int)(reader->write_total - read_total);
+        if (size > reader->ring_size - offset)
+            size = reader->ring_size - offset;
+        pthread_mutex_unlock(&reader->mutex);
+
+        pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+        n = read(reader->fd, reader->ring + offset, size);
+        pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+
+        pthread_mutex_lock(&reader->mutex);
+        reader->syscalls++;
+        if (n > 0)
+            reader->write_total += n;
+        else if (!n)
+            reader->eof = 1;
+        else if (errno != EINTR && errno != EAGAIN) {
+            ERROR("fail to read %s: %s\n", reader->file_name, strerror(errno));
+            reader->error = 1;
+        }
+        pthread_cond_broadcast(&reader->cond);
+    }
+    pthread_mutex_unlock(&reader->mutex);
+
+    return NULL;
+}
+
+static int read_ring(void *opaque, uint8_t *buf, int buf_size)
+{
+    InputReader *reader = (InputReader*)opaque;
+    int64_t t;
+    int offset, size, first;
+
+    pthread_mutex_lock(&reader->mutex);
+    if (reader->write_total == reader->pos && !reader->eof && !reader->error) {
+        t = av_gettime();
+        while (reader->write_total == reader->pos && !reader->eof && !reader->error)
+            pthread_cond_wait(&reader->cond, &reader->mutex);
+        reader->stall_time += av_gettime() - t;
+    }
+    size = reader->write_total - reader->pos < buf_size ? (int)(reader->write_total - reader->pos) : buf_size;
+    pthread_mutex_unlock(&reader->mutex);
+    if (!size)
+        return reader->error ? AVERROR(EIO) : AVERROR_EOF;
+
+    // the filled part can't be overwritten until pos moves past it
+    offset = reader->pos % reader->ring_size;
+    first = reader->ring_size - offset < size ? reader->ring_size - offset : size;
+    memcpy(buf, reader->ring + offset, first);
+    memcpy(buf + first, reader->ring, size - first);
+
+    pthread_mutex_lock(&reader->mutex);
+    reader->pos += size;
+    reader->bytes += size;
+    pthread_cond_broadcast(&reader->cond);
+    pthread_mutex_unlock(&reader->mutex);
+
+    return size;
+}
+
+static int open_mapped(InputReader *reader, int64_t size)
+{
+    reader->map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, reader->fd, 0);
+    if (reader->map == MAP_FAILED) {
+        reader->map = NULL;
+        return -1;
+    }
+    reader->size = size;
+    madvise(reader->map, size, MADV_SEQUENTIAL);
+    reader->syscalls++;
+
+    return 0;
+}
+
+static int open_ring(InputReader *reader)
+{
+    reader->ring_size = reader->buffer_size * INPUT_READ_AHEAD_BUFFERS;
+    reader->ring = av_malloc(reader->ring_size);
+    if (!reader->ring)
+        return -1;
+    pthread_mutex_init(&reader->mutex, NULL);
+    pthread_cond_init(&reader->cond, NULL);
+    if (pthread_create(&reader->thread_id, NULL, read_ahead_thread, reader)) {
+        ERROR("fail to create read ahead thread\n");
+        return -1;
+    }
+    reader->thread_started = 1;
+
+    return 0;
+}
+
+InputReader* input_reader_open(const char *file_name, int buffer_size)
+{
+    InputReader *reader = av_mallocz(sizeof(InputReader));
+    uint8_t *buffer = NULL;
+    struct stat st;
+
+    if (!reader)
+        return NULL;
+    reader->open_time = av_gettime();
+    reader->file_name = strdup(file_name);
+    reader->buffer_size = buffer_size;
+    reader->fd = strcmp(file_name, "-") ? open(file_name, O_RDONLY) : dup(STDIN_FILENO);
+    if (reader->fd < 0 || fstat(reader->fd, &st) < 0) {
+        ERROR("fail to open input file: %s\n", file_name);
+        goto fail;
+    }
+
+    // an empty or unmappable file is read by the thread as well
+    if (S_ISREG(st.st_mode) && st.st_size > 0 && open_mapped(reader, st.st_size) == 0) {
+        buffer = av_malloc(buffer_size);
+        if (buffer)
+            reader->avio = avio_alloc_context(buffer, buffer_size, 0, reader, read_mapped, NULL, seek_mapped);
+    } else if (open_ring(reader) == 0) {
+        buffer = av_malloc(buffer_size);
+        if (buffer)
+            reader->avio = avio_alloc_context(buffer, buffer_size, 0, reader, read_ring, NULL, NULL);
+        if (reader->avio)
+            reader->avio->seekable = 0;
+    }
+    if (!reader->avio) {
+        av_free(buffer);
+        ERROR("fail to create avio context of %s\n", file_name);
+        goto fail;
+    }
+
+    return reader;
+
+fail:
+    input_reader_close(reader);
+    return NULL;
+}
+
+AVIOContext* input_reader_get_avio(InputReader *reader)
+{
+    return reader->avio;
+}
+
+void input_reader_close(InputReader *reader)
+{
+    int64_t elapsed;
+
+    if (!reader)
+        return;
+
+    if (reader->thread_started) {
+        pthread_mutex_lock(&reader->mutex);
+        reader->aborted = 1;
+        pthread_cond_broadcast(&reader->cond);
+        pthread_mutex_unlock(&reader->mutex);
+        // the input may stay open with nothing to read
+        pthread_cancel(reader->thread_id);
+        pthread_join(reader->thread_id, NULL);
+    }
+    if (reader->ring) {
+        pthread_mutex_destroy(&reader->mutex);
+        pthread_cond_destroy(&reader->cond);
+        av_free(reader->ring);
+    }
+    if (reader->map)
+        munmap(reader->map, reader->size);
+    if (reader->fd >= 0)
+        close(reader->fd);
+
+    if (reader->avio) {
+        elapsed = av_gettime() - reader->open_time;
+        PRINTF("input %s (%s): %.2f MB read, %d syscalls (%.1f/s), stall %.2f ms\n", reader->file_name,
+            reader->map ? "mmap" : "read ahead", reader->bytes / 1048576.0, reader->syscalls,
+            elapsed > 0 ? reader->syscalls * 1000000.0 / elapsed : 0.0, reader->stall_time / 1000.0);
+        av_freep(&reader->avio->buffer);
+        av_free(reader->avio);
+    }
+    free(reader->file_name);
+    av_free(reader);
+}
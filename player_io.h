@@ -0,0 +1,40 @@
+/*
+ *  player_io.h - mmap / read-ahead input for avformat
+ *
+ *  Copyright (C) 2015 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef __PLAYER_IO_H__
+#define __PLAYER_IO_H__
+
+#include <libavformat/avio.h>
+
+#define INPUT_READ_AHEAD_BUFFERS 16
+
+typedef struct InputReader InputReader;
+
+// regular files are mmap'ed and read sequentially, pipes, fifos and sockets ("-": stdin) are read
+// ahead by a thread into a ring buffer; buffer_size is the AVIOContext buffer, the read-ahead window
+// is INPUT_READ_AHEAD_BUFFERS of them
+InputReader* input_reader_open(const char *file_name, int buffer_size);
+// set as AVFormatContext.pb before avformat_open_input(), it stays owned by the reader
+AVIOContext* input_reader_get_avio(InputReader *reader);
+// after avformat_close_input(), print the statistics
+void input_reader_close(InputReader *reader);
+
+#endif // __PLAYER_IO_H__
@@ -0,0 +1,219 @@
+/*
+ *  player_latency.c - per frame pipeline latency tracking
+ *
+ *  Copyright (C) 2015 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <libavutil/frame.h>
+#include <libavutil/time.h>
+#include "player_latency.h"
+
+typedef enum {
+    LATENCY_QUEUE,      // demux --> decode submit, time spent in packet queue
+    LATENCY_DECODE,     // decode submit --> decode output, including reorder delay
+    LATENCY_SINK,       // decode output --> sink, time spent in frame queue
+    LATENCY_TOTAL,      // demux --> sink
+    LATENCY_STAGE_COUNT
+} LatencyStage;
+
+static const char *stage_names[LATENCY_STAGE_COUNT] = {"queue", "decode", "sink", "total"};
+
+void latency_init(LatencyTracker *tracker, int64_t start_time)
+{
+    memset(tracker, 0, sizeof(LatencyTracker));
+    tracker->start_time = start_time;
+}
+
+void latency_release(LatencyTracker *tracker)
+{
+    av_freep(&tracker->frames);
+    tracker->frame_count = 0;
+    tracker->frame_capacity = 0;
+}
+
+void latency_submit(LatencyTracker *tracker, int64_t pts, int64_t demux_time)
+{
+    PendingTiming *slot = NULL;
+    int i;
+
+    // reuse a free slot, or the oldest one if packets got lost in decoder
+    for (i = 0; i < LATENCY_PENDING_SIZE; i++) {
+        if (!tracker->pending[i].used) {
+            slot = &tracker->pending[i];
+            break;
+        }
+        if (!slot || tracker->pending[i].seq < slot->seq)
+            slot = &tracker->pending[i];
+    }
+
+    slot->used = 1;
+    slot->pts = pts;
+    slot->seq = tracker->pending_seq++;
+    slot->timing.demux_time = demux_time;
+    slot->timing.submit_time = av_gettime();
+}
+
+FrameTiming* latency_output(LatencyTracker *tracker, int64_t pts)
+{
+    PendingTiming *slot = NULL, *oldest = NULL;
+    FrameTiming *timing;
+    int64_t now = av_gettime();
+    int i;
+
+    for (i = 0; i < LATENCY_PENDING_SIZE; i++) {
+        if (!tracker->pending[i].used)
+            continue;
+        if (pts != AV_NOPTS_VALUE && tracker->pending[i].pts == pts) {
+            slot = &tracker->pending[i];
+            break;
+        }
+        if (!oldest || tracker->pending[i].seq < oldest->seq)
+            oldest = &tracker->pending[i];
+    }
+    // without a matching pts, assume the frames come out in decode order
+    if (!slot)
+        slot = oldest;
+
+    timing = av_malloc(sizeof(FrameTiming));
+    if (!timing)
+        return NULL;
+    if (slot) {
+        *timing = slot->timing;
+        slot->used = 0;
+    } else
+        timing->demux_time = timing->submit_time = now;
+    timing->output_time = now;
+    timing->sink_time = 0;
+
+    return timing;
+}
+
+void latency_sink(LatencyTracker *tracker, FrameTiming *timing)
+{
+    if (!timing)
+        return;
+
+    if (tracker->frame_count == tracker->frame_capacity) {
+        int capacity = tracker->frame_capacity ? tracker->frame_capacity * 2 : 1024;
+        FrameTiming *frames = av_realloc(tracker->frames, capacity * sizeof(FrameTiming));
+        if (!frames) {
+            av_free(timing);
+            return;
+        }
+        tracker->frames = frames;
+        tracker->frame_capacity = capacity;
+    }
+
+    timing->sink_time = av_gettime();
+    tracker->frames[tracker->frame_count++] = *timing;
+    av_free(timing);
+}
+
+static int compare_int64(const void *a, const void *b)
+{
+    int64_t va = *(const int64_t*)a, vb = *(const int64_t*)b;
+
+    return va < vb ? -1 : (va > vb ? 1 : 0);
+}
+
+static int64_t stage_latency(const FrameTiming *timing, LatencyStage stage)
+{
+    switch (stage) {
+    case LATENCY_QUEUE:
+        return timing->submit_time - timing->demux_time;
+    case LATENCY_DECODE:
+        return timing->output_time - timing->submit_time;
+    case LATENCY_SINK:
+        return timing->sink_time - timing->output_time;
+    default:
+        return timing->sink_time - timing->demux_time;
+    }
+}
+
+// nearest-rank percentile of sorted samples, in ms
+static double percentile(const int64_t *samples, int count, int p)
+{
+    int index = (int)(((int64_t)count * p + 99) / 100) - 1;
+
+    if (!count)
+        return 0.0;
+    if (index < 0)
+        index = 0;
+    return samples[index] / 1000.0;
+}
+
+static void print_json_string(FILE *fp, const char *str)
+{
+    fputc('"', fp);
+    for (; str && *str; str++) {
+        if (*str == '"' || *str == '\\')
+            fputc('\\', fp);
+        if ((unsigned char)*str >= 0x20)
+            fputc(*str, fp);
+    }
+    fputc('"', fp);
+}
+
+// ms between two startup steps, 0 if either isn't reached
+static double startup_step(int64_t from, int64_t to)
+{
+    return from && to ? (to - from) / 1000.0 : 0.0;
+}
+
+void latency_print_json(LatencyTracker *tracker, FILE *fp, const char *input_file, const StartupTiming *startup)
+{
+    int count = tracker->frame_count;
+    int64_t *samples = NULL;
+    int64_t elapsed = 0;
+    int stage, i;
+
+    if (count) {
+        samples = av_malloc(count * sizeof(int64_t));
+        elapsed = tracker->frames[count - 1].sink_time - tracker->frames[0].demux_time;
+    }
+
+    fprintf(fp, "{\"input\": ");
+    print_json_string(fp, input_file);
+    fprintf(fp, ", \"frames\": %d, \"elapsed_ms\": %.3f, \"fps\": %.2f, \"time_to_first_frame_ms\": %.3f, \"latency_ms\": {",
+        count, elapsed / 1000.0, elapsed > 0 ? count * 1000000.0 / elapsed : 0.0,
+        count ? (tracker->frames[0].sink_time - tracker->start_time) / 1000.0 : 0.0);
+    for (stage = 0; stage < LATENCY_STAGE_COUNT; stage++) {
+        if (samples) {
+            for (i = 0; i < count; i++)
+                samples[i] = stage_latency(&tracker->frames[i], stage);
+            qsort(samples, count, sizeof(int64_t), compare_int64);
+        }
+        fprintf(fp, "%s\"%s\": {\"p50\": %.3f, \"p95\": %.3f, \"p99\": %.3f, \"max\": %.3f}",
+            stage ? ", " : "", stage_names[stage],
+            percentile(samples, samples ? count : 0, 50), percentile(samples, samples ? count : 0, 95),
+            percentile(samples, samples ? count : 0, 99), samples ? samples[count - 1] / 1000.0 : 0.0);
+    }
+    fprintf(fp, "}");
+    if (startup)
+        fprintf(fp, ", \"startup_ms\": {\"wait\": %.3f, \"open\": %.3f, \"probe\": %.3f, \"codec\": %.3f, "
+            "\"first_packet\": %.3f, \"first_frame\": %.3f, \"time_to_first_frame\": %.3f}",
+            startup_step(startup->open_start, startup->open_locked), startup_step(startup->open_locked, startup->input_opened),
+            startup_step(startup->input_opened, startup->info_found), startup_step(startup->info_found, startup->codec_opened),
+            startup_step(startup->codec_opened, startup->first_packet), startup_step(startup->first_packet, startup->first_frame),
+            startup_step(startup->open_start, startup->first_frame));
+    fprintf(fp, "}");
+
+    av_free(samples);
+}
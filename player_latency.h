@@ -0,0 +1,80 @@
+/*
+ *  player_latency.h - per frame pipeline latency tracking
+ *
+ *  Copyright (C) 2015 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef __PLAYER_LATENCY_H__
+#define __PLAYER_LATENCY_H__
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define LATENCY_PENDING_SIZE 64 // packets in decoder (reorder delay + decoder input queue)
+
+// wall clock (us) of one frame at each pipeline stage
+typedef struct {
+    int64_t demux_time;
+    int64_t submit_time;
+    int64_t output_time;
+    int64_t sink_time;
+} FrameTiming;
+
+// wall clock (us) of the startup steps of a session, 0: not reached
+typedef struct {
+    int64_t open_start;     // a worker picked the session
+    int64_t open_locked;    // got the open lock
+    int64_t input_opened;   // container header parsed
+    int64_t info_found;     // stream info probed (== input_opened when skipped)
+    int64_t codec_opened;
+    int64_t first_packet;   // first video packet demuxed
+    int64_t first_frame;    // first frame through the sink
+} StartupTiming;
+
+typedef struct {
+    int64_t pts;
+    int64_t seq;
+    int used;
+    FrameTiming timing;
+} PendingTiming;
+
+typedef struct {
+    int64_t start_time;
+
+    // accessed by the decode thread only
+    PendingTiming pending[LATENCY_PENDING_SIZE];
+    int64_t pending_seq;
+
+    // accessed by the sink thread only
+    FrameTiming *frames;
+    int frame_count;
+    int frame_capacity;
+} LatencyTracker;
+
+void latency_init(LatencyTracker *tracker, int64_t start_time);
+void latency_release(LatencyTracker *tracker);
+// a packet demuxed at demux_time is sent to decoder now
+void latency_submit(LatencyTracker *tracker, int64_t pts, int64_t demux_time);
+// decoder outputs the frame of the packet with pts, the returned timing travels with the frame (av_free it)
+FrameTiming* latency_output(LatencyTracker *tracker, int64_t pts);
+// the frame reaches the sink, takes the ownership of timing
+void latency_sink(LatencyTracker *tracker, FrameTiming *timing);
+// print the report as a json object, without trailing new line, startup can be NULL
+void latency_print_json(LatencyTracker *tracker, FILE *fp, const char *input_file, const StartupTiming *startup);
+
+#endif // __PLAYER_LATENCY_H__
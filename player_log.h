@@ -0,0 +1,44 @@
+/*
+ *  player_log.h - debug, log and assert macros shared by the player modules
+ *
+ *  Copyright (C) 2015 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef __PLAYER_LOG_H__
+#define __PLAYER_LOG_H__
+
+#include <stdio.h>
+#include <assert.h>
+
+#ifdef PLAYER_DEBUG
+#define DEBUG(format, ...)   printf("  %s, %d, " format, __FILE__, __LINE__, ##__VA_ARGS__)
+#else
+#define DEBUG(...)
+#endif
+#define PRINTF printf
+#define ERROR(format, ...) fprintf(stderr, "!!ERROR  %s, %d, " format, __FILE__, __LINE__, ##__VA_ARGS__)
+
+#ifndef ASSERT
+#define ASSERT(expr) do {                                                                                               \
+        if (!(expr))                                                                                                    \
+            ERROR();                                                                                                    \
+        assert(expr);                                                                                                   \
+    } while(0)
+#endif
+
+#endif // __PLAYER_LOG_H__
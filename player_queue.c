@@ -0,0 +1,143 @@
+/*
+ *  player_queue.c - bounded blocking queue between player pipeline stages
+ *
+ *  Copyright (C) 2015 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include "player_queue.h"
+#include "player_log.h"
+
+PlayerQueue* queue_create(int capacity)
+{
+    PlayerQueue *queue = calloc(1, sizeof(PlayerQueue));
+
+    if (!queue)
+        return NULL;
+    queue->items = calloc(capacity, sizeof(void*));
+    if (!queue->items) {
+        free(queue);
+        return NULL;
+    }
+    queue->capacity = capacity;
+    pthread_mutex_init(&queue->mutex, NULL);
+    pthread_cond_init(&queue->not_empty, NULL);
+    pthread_cond_init(&queue->not_full, NULL);
+
+    return queue;
+}
+
+void queue_destroy(PlayerQueue *queue, void (*free_item)(void *item))
+{
+    if (!queue)
+        return;
+
+    queue_flush(queue, free_item);
+    pthread_mutex_destroy(&queue->mutex);
+    pthread_cond_destroy(&queue->not_empty);
+    pthread_cond_destroy(&queue->not_full);
+    free(queue->items);
+    free(queue);
+}
+
+int queue_push(PlayerQueue *queue, void *item)
+{
+    pthread_mutex_lock(&queue->mutex);
+    while (queue->count == queue->capacity && !queue->aborted)
+        pthread_cond_wait(&queue->not_full, &queue->mutex);
+    if (queue->aborted) {
+        pthread_mutex_unlock(&queue->mutex);
+        return -1;
+    }
+
+    queue->items[(queue->head + queue->count) % queue->capacity] = item;
+    queue->count++;
+    queue->occupancy_sum += queue->count;
+    queue->occupancy_samples++;
+    if (queue->count > queue->occupancy_max)
+        queue->occupancy_max = queue->count;
+    pthread_cond_signal(&queue->not_empty);
+    pthread_mutex_unlock(&queue->mutex);
+
+    return 0;
+}
+
+void* queue_pop(PlayerQueue *queue)
+{
+    void *item = NULL;
+
+    pthread_mutex_lock(&queue->mutex);
+    while (!queue->count && !queue->finished && !queue->aborted)
+        pthread_cond_wait(&queue->not_empty, &queue->mutex);
+    if (queue->count && !queue->aborted) {
+        item = queue->items[queue->head];
+        queue->head = (queue->head + 1) % queue->capacity;
+        queue->count--;
+        pthread_cond_signal(&queue->not_full);
+    }
+    pthread_mutex_unlock(&queue->mutex);
+
+    return item;
+}
+
+void queue_flush(PlayerQueue *queue, void (*free_item)(void *item))
+{
+    pthread_mutex_lock(&queue->mutex);
+    while (queue->count) {
+        if (free_item)
+            free_item(queue->items[queue->head]);
+        queue->head = (queue->head + 1) % queue->capacity;
+        queue->count--;
+    }
+    pthread_cond_broadcast(&queue->not_full);
+    pthread_mutex_unlock(&queue->mutex);
+}
+
+void queue_finish(PlayerQueue *queue)
+{
+    pthread_mutex_lock(&queue->mutex);
+    queue->finished = 1;
+    pthread_cond_broadcast(&queue->not_empty);
+    pthread_mutex_unlock(&queue->mutex);
+}
+
+void queue_abort(PlayerQueue *queue)
+{
+    pthread_mutex_lock(&queue->mutex);
+    queue->aborted = 1;
+    pthread_cond_broadcast(&queue->not_empty);
+    pthread_cond_broadcast(&queue->not_full);
+    pthread_mutex_unlock(&queue->mutex);
+}
+
+int queue_size(PlayerQueue *queue)
+{
+    int count;
+
+    pthread_mutex_lock(&queue->mutex);
+    count = queue->count;
+    pthread_mutex_unlock(&queue->mutex);
+
+    return count;
+}
+
+void queue_print_stats(PlayerQueue *queue, const char *name)
+{
+    PRINTF("%s queue: capacity %d, average occupancy %.2f, max occupancy %d\n", name, queue->capacity,
+        queue->occupancy_samples ? (double)queue->occupancy_sum / queue->occupancy_samples : 0.0, queue->occupancy_max);
+}
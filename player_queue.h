@@ -0,0 +1,59 @@
+/*
+ *  player_queue.h - bounded blocking queue between player pipeline stages
+ *
+ *  Copyright (C) 2015 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef __PLAYER_QUEUE_H__
+#define __PLAYER_QUEUE_H__
+
+#include <stdint.h>
+#include <pthread.h>
+
+typedef struct {
+    void            **items;
+    int             capacity;
+    int             head;
+    int             count;
+    int             finished;   // producer is done, pop() returns NULL once the queue is empty
+    int             aborted;    // push()/pop() return immediately
+    pthread_mutex_t mutex;
+    pthread_cond_t  not_empty;
+    pthread_cond_t  not_full;
+
+    // statistics, occupancy is sampled on each push
+    int64_t         occupancy_sum;
+    int             occupancy_samples;
+    int             occupancy_max;
+} PlayerQueue;
+
+PlayerQueue* queue_create(int capacity);
+// free_item releases the items still queued, it can be NULL
+void queue_destroy(PlayerQueue *queue, void (*free_item)(void *item));
+// block while the queue is full, return -1 if the queue is aborted
+int queue_push(PlayerQueue *queue, void *item);
+// block while the queue is empty, return NULL once it is finished and empty, or aborted
+void* queue_pop(PlayerQueue *queue);
+// release the queued items, pushes may still happen on an aborted queue
+void queue_flush(PlayerQueue *queue, void (*free_item)(void *item));
+void queue_finish(PlayerQueue *queue);
+void queue_abort(PlayerQueue *queue);
+int queue_size(PlayerQueue *queue);
+void queue_print_stats(PlayerQueue *queue, const char *name);
+
+#endif // __PLAYER_QUEUE_H__
@@ -0,0 +1,167 @@
+/*
+ *  player_scheduler.c - pts driven presentation scheduler
+ *
+ *  Copyright (C) 2015 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+#include <libavutil/time.h>
+#include "player_scheduler.h"
+#include "player_log.h"
+
+#define DEFAULT_FRAME_DURATION  40000       // us, 25 fps
+#define MAX_CLOCK_DRIFT         10000000    // us, larger gaps are taken as pts discontinuity and reset the clock
+#define SKIP_ENTER_LATE_FRAMES  3           // drops without an in-time frame between before asking decoder to skip non-ref frames
+#define SKIP_LEAVE_ON_TIME      25          // consecutive in-time frames before decoding all frames again
+
+static int64_t abs64(int64_t v)
+{
+    return v < 0 ? -v : v;
+}
+
+static void set_skip_nonref(PresentScheduler *scheduler, int skip)
+{
+    if (scheduler->skip_nonref == skip)
+        return;
+
+    DEBUG("%s decoder non-ref frame skipping\n", skip ? "enable" : "disable");
+    __atomic_store_n(&scheduler->skip_nonref, skip, __ATOMIC_RELAXED);
+    scheduler->skip_switches++;
+}
+
+void scheduler_init(PresentScheduler *scheduler, int enabled, AVRational time_base, AVRational frame_rate)
+{
+    memset(scheduler, 0, sizeof(PresentScheduler));
+    scheduler->enabled = enabled;
+    scheduler->time_base = time_base;
+    if (frame_rate.num > 0 && frame_rate.den > 0)
+        scheduler->frame_duration = av_rescale_q(1, (AVRational){frame_rate.den, frame_rate.num}, AV_TIME_BASE_Q);
+    if (scheduler->frame_duration <= 0)
+        scheduler->frame_duration = DEFAULT_FRAME_DURATION;
+    scheduler->clock_base_pts = AV_NOPTS_VALUE;
+    scheduler->frame_pts = AV_NOPTS_VALUE;
+    scheduler->last_present_pts = AV_NOPTS_VALUE;
+}
+
+void scheduler_reset(PresentScheduler *scheduler)
+{
+    scheduler->clock_base_pts = AV_NOPTS_VALUE;
+    scheduler->frame_pts = AV_NOPTS_VALUE;
+    scheduler->last_present_pts = AV_NOPTS_VALUE;
+    scheduler->late_frames = 0;
+    scheduler->on_time_frames = 0;
+    // the new position starts with all frames decoded, lateness there enables skipping again
+    set_skip_nonref(scheduler, 0);
+}
+
+int scheduler_wait(PresentScheduler *scheduler, AVFrame *frame)
+{
+    int64_t pts = av_frame_get_best_effort_timestamp(frame);
+    int64_t now, delay;
+
+    if (!scheduler->enabled)
+        return 1;
+
+    if (pts != AV_NOPTS_VALUE && scheduler->time_base.num && scheduler->time_base.den)
+        pts = av_rescale_q(pts, scheduler->time_base, AV_TIME_BASE_Q);
+    else if (scheduler->frame_pts != AV_NOPTS_VALUE)
+        pts = scheduler->frame_pts + scheduler->frame_duration;
+    else
+        pts = 0;
+    scheduler->frame_pts = pts;
+
+    now = av_gettime();
+    if (scheduler->clock_base_pts == AV_NOPTS_VALUE ||
+        abs64((pts - scheduler->clock_base_pts) - (now - scheduler->clock_base_time)) > MAX_CLOCK_DRIFT) {
+        scheduler->clock_base_time = now;
+        scheduler->clock_base_pts = pts;
+        scheduler->last_present_pts = AV_NOPTS_VALUE;
+    }
+    scheduler->target_time = scheduler->clock_base_time + pts - scheduler->clock_base_pts;
+
+    delay = scheduler->target_time - now;
+    if (delay > 0) {
+        av_usleep(delay);
+        return 1;
+    }
+
+    // more than one frame late: drop it before spending time on upload/import and swap
+    if (-delay > scheduler->frame_duration) {
+        scheduler->dropped++;
+        scheduler->on_time_frames = 0;
+        if (++scheduler->late_frames >= SKIP_ENTER_LATE_FRAMES)
+            set_skip_nonref(scheduler, 1);
+        return 0;
+    }
+
+    return 1;
+}
+
+void scheduler_presented(PresentScheduler *scheduler)
+{
+    int64_t now = av_gettime();
+    int64_t lateness, jitter;
+
+    scheduler->presented++;
+    if (!scheduler->enabled)
+        return;
+
+    lateness = now - scheduler->target_time;
+    if (lateness < 0)
+        lateness = 0;
+    scheduler->lateness_sum += lateness;
+    if (lateness > scheduler->lateness_max)
+        scheduler->lateness_max = lateness;
+
+    // jitter: difference between the display interval and the pts interval of consecutive frames
+    if (scheduler->last_present_pts != AV_NOPTS_VALUE) {
+        jitter = abs64((now - scheduler->last_present_time) - (scheduler->frame_pts - scheduler->last_present_pts));
+        scheduler->jitter_sum += jitter;
+        if (jitter > scheduler->jitter_max)
+            scheduler->jitter_max = jitter;
+        scheduler->jitter_samples++;
+    }
+    scheduler->last_present_time = now;
+    scheduler->last_present_pts = scheduler->frame_pts;
+
+    if (lateness <= scheduler->frame_duration / 2) {
+        scheduler->late_frames = 0;
+        if (++scheduler->on_time_frames >= SKIP_LEAVE_ON_TIME)
+            set_skip_nonref(scheduler, 0);
+    } else
+        scheduler->on_time_frames = 0;
+}
+
+enum AVDiscard scheduler_get_skip_frame(PresentScheduler *scheduler)
+{
+    return __atomic_load_n(&scheduler->skip_nonref, __ATOMIC_RELAXED) ? AVDISCARD_NONREF : AVDISCARD_DEFAULT;
+}
+
+void scheduler_print_stats(PresentScheduler *scheduler)
+{
+    if (!scheduler->enabled)
+        return;
+
+    PRINTF("scheduler: presented %d, dropped %d, decoder skip switches %d\n",
+        scheduler->presented, scheduler->dropped, scheduler->skip_switches);
+    PRINTF("scheduler: lateness average %.2f ms max %.2f ms, jitter average %.2f ms max %.2f ms\n",
+        scheduler->presented ? scheduler->lateness_sum / 1000.0 / scheduler->presented : 0.0,
+        scheduler->lateness_max / 1000.0,
+        scheduler->jitter_samples ? scheduler->jitter_sum / 1000.0 / scheduler->jitter_samples : 0.0,
+        scheduler->jitter_max / 1000.0);
+}
@@ -0,0 +1,68 @@
+/*
+ *  player_scheduler.h - pts driven presentation scheduler
+ *
+ *  Copyright (C) 2015 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+#ifndef __PLAYER_SCHEDULER_H__
+#define __PLAYER_SCHEDULER_H__
+
+#include <stdint.h>
+#include <libavcodec/avcodec.h>
+
+typedef struct {
+    int enabled;                // 0: present every frame immediately
+    AVRational time_base;       // time base of frame pts
+    int64_t frame_duration;     // us, used for frames without pts and as drop threshold
+
+    // presentation clock: pts clock_base_pts is due at wall time clock_base_time
+    int64_t clock_base_time;
+    int64_t clock_base_pts;
+    int64_t frame_pts;          // us, pts of the frame being scheduled
+    int64_t target_time;        // wall time the frame is due
+
+    // decoder feedback, read by the decode thread
+    int skip_nonref;
+    int late_frames;            // dropped frames since the last frame presented in time
+    int on_time_frames;         // consecutive frames presented in time
+
+    // statistics
+    int presented;
+    int dropped;
+    int skip_switches;
+    int64_t lateness_sum;
+    int64_t lateness_max;
+    int64_t last_present_time;
+    int64_t last_present_pts;
+    int64_t jitter_sum;
+    int64_t jitter_max;
+    int jitter_samples;
+} PresentScheduler;
+
+void scheduler_init(PresentScheduler *scheduler, int enabled, AVRational time_base, AVRational frame_rate);
+// wait until the frame is due, return 0 if it is too late and should be dropped before rendering
+int scheduler_wait(PresentScheduler *scheduler, AVFrame *frame);
+// restart the presentation clock from the next frame, after a seek
+void scheduler_reset(PresentScheduler *scheduler);
+// record the frame (scheduled by the last scheduler_wait) as presented
+void scheduler_presented(PresentScheduler *scheduler);
+// skip_frame setting the decoder should use, called from the decode thread
+enum AVDiscard scheduler_get_skip_frame(PresentScheduler *scheduler);
+void scheduler_print_stats(PresentScheduler *scheduler);
+
+#endif // __PLAYER_SCHEDULER_H__
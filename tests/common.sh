@@ -0,0 +1,53 @@
+#
+#  common.sh - shared by the clip tests, sourced after CLIP is set
+#
+#  dump_frames decodes the clip to y4m (mode 0) and keeps the md5 of every frame (all three planes),
+#  compare_frames compares two such dumps and reports the first differing frame.
+#
+#  env: PLAYER player binary (default ./player)
+#
+
+PLAYER=${PLAYER:-./player}
+WORK=${TMPDIR:-/tmp}/$(basename $0 .sh).$$
+
+mkdir -p $WORK || exit 1
+trap 'rm -rf $WORK' EXIT
+
+# name, then the player arguments: $WORK/<name>.md5 gets one line per frame
+dump_frames() {
+    name=$1
+    shift
+    if ! $PLAYER -i "$CLIP" -m 0 -n -o $WORK/$name.y4m "$@" > /dev/null 2>&1; then
+        echo "$name: player failed" >&2
+        return 1
+    fi
+    header=$(head -n 1 $WORK/$name.y4m)
+    width=$(echo "$header" | sed -n 's/.* W\([0-9]*\) .*/\1/p')
+    height=$(echo "$header" | sed -n 's/.* H\([0-9]*\) .*/\1/p')
+    if [ -z "$width" ] || [ -z "$height" ]; then
+        echo "$name: not a y4m dump" >&2
+        return 1
+    fi
+    # "FRAME\n" and the I420 planes
+    frame_size=$((6 + width * height + 2 * ((width + 1) / 2) * ((height + 1) / 2)))
+    mkdir -p $WORK/$name
+    tail -c +$((${#header} + 2)) $WORK/$name.y4m | (cd $WORK/$name && split -d -a 6 -b $frame_size - frame_)
+    (cd $WORK/$name && md5sum frame_*) > $WORK/$name.md5
+    rm -rf $WORK/$name $WORK/$name.y4m
+    if [ ! -s $WORK/$name.md5 ]; then
+        echo "$name: no frames decoded" >&2
+        return 1
+    fi
+}
+
+# reference name, test name (dumped by dump_frames): 1 and a FAIL line if any frame differs or is missing;
+# frames is set to the frame count of the reference
+compare_frames() {
+    frames=$(wc -l < $WORK/$1.md5)
+    if cmp -s $WORK/$1.md5 $WORK/$2.md5; then
+        return 0
+    fi
+    first=$(diff $WORK/$1.md5 $WORK/$2.md5 | sed -n "s/^[<>] [0-9a-f]*  frame_0*\([0-9]\)/\1/p" | head -n 1)
+    echo "FAIL: $2 differs from $1 ($(wc -l < $WORK/$2.md5) frames, $frames in $1), first at frame $first" >&2
+    return 1
+}
@@ -0,0 +1,51 @@
+#!/bin/sh
+#
+#  latency_bench.sh - per frame decode latency of the libyami wrapper over a clip
+#
+#  the null sink (-m 4) reports the time from a packet entering the decoder to its frame coming
+#  out, as p50/p95/p99/max over all frames; the clip is decoded once per input queue depth, and
+#  once more in low delay mode (-d). with the signalled handoff these are in the microsecond
+#  range plus the decode time itself, a polling wrapper shows a 10 ms floor.
+#
+#  usage: latency_bench.sh <clip> [queue depths, default "1 2 4 8 16"], skipped without a clip
+#  env: PLAYER player binary (default ./player), DECODER_OPTS extra -c options (e.g. backend=sw)
+#
+
+CLIP=$1
+DEPTHS=${2:-"1 2 4 8 16"}
+PLAYER=${PLAYER:-./player}
+REPORT=${TMPDIR:-/tmp}/latency_bench.$$.json
+
+# make bench without CLIP= has nothing to measure, it passes
+if [ -z "$CLIP" ]; then
+    echo "SKIP: $0 needs a clip (usage: $0 <clip> [queue depths], or CLIP=<clip> for make)"
+    exit 0
+fi
+trap 'rm -f $REPORT' EXIT
+
+# depth ("low_delay" for -d), then the player arguments
+run() {
+    name=$1
+    shift
+    if ! $PLAYER -i "$CLIP" -m 4 -n -j $REPORT ${DECODER_OPTS:+-c $DECODER_OPTS} "$@" > /dev/null 2>&1; then
+        echo "$name: player failed" >&2
+        return 1
+    fi
+    frames=$(sed -n 's/^[^[]*"frames": \([0-9]*\),.*/\1/p' $REPORT)
+    fps=$(sed -n 's/^[^[]*"fps": \([0-9.]*\),.*/\1/p' $REPORT)
+    decode=$(sed -n 's/.*"decode": {"p50": \([0-9.]*\), "p95": \([0-9.]*\), "p99": \([0-9.]*\), "max": \([0-9.]*\)}.*/\1 \2 \3 \4/p' $REPORT)
+    if [ -z "$frames" ] || [ "$frames" -eq 0 ] || [ -z "$decode" ]; then
+        echo "$name: no frames decoded" >&2
+        return 1
+    fi
+    printf "%-10s %10s %10s %10s %10s %10s\n" $name $fps $decode
+}
+
+printf "%-10s %10s %10s %10s %10s %10s\n" depth fps p50_ms p95_ms p99_ms max_ms
+status=0
+for depth in $DEPTHS; do
+    run $depth -q $depth || status=1
+done
+run low_delay -q 1 -d || status=1
+
+exit $status
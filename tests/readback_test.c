@@ -0,0 +1,182 @@
+/*
+ *  readback_test.c - yuv shaders against a cpu reference conversion
+ *
+ *  Copyright (C) 2015 Intel Corporation
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free
+ *  Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ *  Boston, MA 02110-1301 USA
+ */
+
+// a known frame is uploaded (I420, then NV12), converted by the yuv shader into a video sized fbo
+// and read back through the pbo path (offscreen, no X display needed); every pixel must be within
+// +-1 of the cpu conversion. chroma is flat in 16x16 luma blocks and pixels next to a block edge
+// are skipped, so the result doesn't depend on how the gpu interpolates chroma.
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "video_gl_render.h"
+
+#define WIDTH       320
+#define HEIGHT      240
+#define PITCH       (WIDTH + 32)    // padded rows, like decoder surfaces
+#define BLOCK       16              // luma pixels per flat chroma block
+#define TOLERANCE   1
+
+// rgb = y_scale * (y - y_offset) + matrix * (u - 128, v - 128)
+typedef struct {
+    const char *name;
+    int isBT709;
+    int isFullRange;
+    double yScale, yOffset;
+    double rv, gu, gv, bu;
+} ColorSpace;
+
+// coefficients as published for 8 bit video, independent of the shader's derivation from Kr/Kb
+static const ColorSpace color_spaces[] = {
+    { "BT.601 limited", 0, 0, 1.164383, 16.0, 1.596027, -0.391762, -0.812968, 2.017232 },
+    { "BT.601 full",    0, 1, 1.0,       0.0, 1.402000, -0.344136, -0.714136, 1.772000 },
+    { "BT.709 limited", 1, 0, 1.164383, 16.0, 1.792741, -0.213249, -0.532909, 2.112402 },
+};
+#define COLOR_SPACE_COUNT (int)(sizeof(color_spaces) / sizeof(color_spaces[0]))
+
+static uint8_t luma[PITCH * HEIGHT];
+static uint8_t chroma_u[PITCH / 2 * HEIGHT / 2];
+static uint8_t chroma_v[PITCH / 2 * HEIGHT / 2];
+static uint8_t chroma_uv[PITCH * HEIGHT / 2];   // NV12
+static int received;
+static int failures;
+
+static uint8_t clamp_round(double value)
+{
+    if (value <= 0.0)
+        return 0;
+    if (value >= 255.0)
+        return 255;
+    return (uint8_t)floor(value + 0.5);
+}
+
+// luma covers the whole range incl. footroom/headroom, chroma blocks hit the corners of the uv plane
+static void fill_frame(void)
+{
+    uint32_t seed = 1;
+    int x, y;
+
+    for (y = 0; y < HEIGHT; y++) {
+        for (x = 0; x < WIDTH; x++) {
+            seed = seed * 1103515245 + 12345;
+            luma[y * PITCH + x] = (uint8_t)((x * 255 / (WIDTH - 1) + (seed >> 16) % 32) & 0xff);
+        }
+    }
+    for (y = 0; y < HEIGHT / 2; y++) {
+        for (x = 0; x < WIDTH / 2; x++) {
+            int block = (y / (BLOCK / 2)) * (WIDTH / BLOCK) + x / (BLOCK / 2);
+            uint8_t u = (uint8_t)((block * 37) & 0xff);
+            uint8_t v = (uint8_t)((255 - block * 59) & 0xff);
+            chroma_u[y * PITCH / 2 + x] = u;
+            chroma_v[y * PITCH / 2 + x] = v;
+            chroma_uv[y * PITCH + 2 * x] = u;
+            chroma_uv[y * PITCH + 2 * x + 1] = v;
+        }
+    }
+}
+
+static void check_readback(void *opaque, void *tag, int index, const uint8_t *rgb, int width, int height)
+{
+    const ColorSpace *cs = &color_spaces[(intptr_t)tag];
+    const char *format = (const char*)opaque;
+    int x, y, c, max_diff = 0, checked = 0, bad = 0;
+
+    received++;
+    if (width != WIDTH || height != HEIGHT) {
+        ERROR("%s %s: readback is %dx%d, not %dx%d\n", format, cs->name, width, height, WIDTH, HEIGHT);
+        failures++;
+        return;
+    }
+    for (y = 0; y < HEIGHT; y++) {
+        for (x = 0; x < WIDTH; x++) {
+            double luma_value, u, v;
+            uint8_t expected[3];
+            const uint8_t *pixel = rgb + (y * WIDTH + x) * 3;
+
+            if (x % BLOCK < 2 || x % BLOCK >= BLOCK - 2 || y % BLOCK < 2 || y % BLOCK >= BLOCK - 2)
+                continue;
+            luma_value = cs->yScale * (luma[y * PITCH + x] - cs->yOffset);
+            u = chroma_u[y / 2 * PITCH / 2 + x / 2] - 128.0;
+            v = chroma_v[y / 2 * PITCH / 2 + x / 2] - 128.0;
+            expected[0] = clamp_round(luma_value + cs->rv * v);
+            expected[1] = clamp_round(luma_value + cs->gu * u + cs->gv * v);
+            expected[2] = clamp_round(luma_value + cs->bu * u);
+            for (c = 0; c < 3; c++) {
+                int diff = abs(pixel[c] - expected[c]);
+                if (diff > max_diff)
+                    max_diff = diff;
+                if (diff > TOLERANCE && bad++ < 4)
+                    ERROR("%s %s: pixel %d,%d channel %d is %d, expected %d\n", format, cs->name, x, y, c, pixel[c], expected[c]);
+            }
+            checked++;
+        }
+    }
+    PRINTF("%s %s: %d pixels, max difference %d%s\n", format, cs->name, checked, max_diff, bad ? " FAIL" : "");
+    if (bad)
+        failures++;
+}
+
+static int run_format(uint32_t fourcc, const char *format)
+{
+    uint8_t *planes[3] = { luma, chroma_u, chroma_v };
+    uint32_t pitches[3] = { PITCH, PITCH / 2, PITCH / 2 };
+    int sizes[2] = { WIDTH, HEIGHT };
+    intptr_t i;
+
+    if (fourcc == YUV_FOURCC_NV12) {
+        planes[1] = chroma_uv;
+        planes[2] = NULL;
+        pitches[1] = PITCH;
+        pitches[2] = 0;
+    }
+    setVideoOffscreen(1);
+    if (setVideoReadback(sizes, 1, check_readback, (void*)format) < 0)
+        return -1;
+    for (i = 0; i < COLOR_SPACE_COUNT; i++) {
+        setVideoColorSpace(color_spaces[i].isBT709, color_spaces[i].isFullRange);
+        if (readbackVideoRaw(planes, pitches, fourcc, WIDTH, HEIGHT, (void*)i) < 0) {
+            ERROR("%s: readback failed\n", format);
+            return -1;
+        }
+    }
+    flushVideoReadback();
+    deinit_egl();
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    fill_frame();
+    if (run_format(YUV_FOURCC_I420, "I420") < 0 || run_format(YUV_FOURCC_NV12, "NV12") < 0)
+        return 1;
+    if (received != 2 * COLOR_SPACE_COUNT) {
+        ERROR("%d of %d readbacks delivered\n", received, 2 * COLOR_SPACE_COUNT);
+        return 1;
+    }
+    if (failures) {
+        ERROR("%d of %d readbacks differ from the reference by more than %d\n", failures, received, TOLERANCE);
+        return 1;
+    }
+    PRINTF("PASS\n");
+
+    return 0;
+}
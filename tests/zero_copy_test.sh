@@ -0,0 +1,24 @@
+#!/bin/sh
+#
+#  zero_copy_test.sh - zero copy raw output (-z) must give the same planes as the copy path
+#
+#  the clip is dumped twice by mode 0 as y4m, with and without -z, and the md5 of every frame
+#  (all three planes) is compared; the first differing frame is reported.
+#
+#  usage: zero_copy_test.sh <clip>, skipped without one
+#  env: PLAYER player binary (default ./player), DECODER_OPTS extra -c options (e.g. backend=sw)
+#
+
+CLIP=$1
+
+# make check without CLIP= runs the clip independent tests only
+if [ -z "$CLIP" ]; then
+    echo "SKIP: $0 needs a clip (usage: $0 <clip>, or CLIP=<clip> for make)"
+    exit 0
+fi
+. $(dirname $0)/common.sh
+
+dump_frames copy ${DECODER_OPTS:+-c $DECODER_OPTS} || exit 1
+dump_frames zero_copy ${DECODER_OPTS:+-c $DECODER_OPTS} -z || exit 1
+compare_frames copy zero_copy || exit 1
+echo "PASS: $frames frames bit identical with and without zero copy"
@@ -21,18 +21,133 @@
  */
 
 #include "gles2_help.h"
+#include <GLES3/gl3.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
+#include <sys/time.h>
 #include "EGL/eglext.h"
 #include "egl_util.h"
 #include "video_gl_render.h"
 
-static int init_egl(uint32_t width, uint32_t height, int is_dmabuf);
+static int init_egl(uint32_t width, uint32_t height, uint32_t fourcc, int is_dmabuf);
+static Window create_x11_window(uint32_t width, uint32_t height);
 static EGLContextType *egl_context = NULL;
+static EGLContextType *prepared_context = NULL;  // by prepareVideoRender(), without a surface yet
 static Display * x11_display = NULL;
 static Window x11_window = 0;
 
+#define UPLOAD_PBO_COUNT 3
+// texture allocated once per resolution and updated by glTexSubImage2D, from a ring of
+// pixel unpack buffers when gles3 is available
+typedef struct {
+    GLuint      tex;
+    GLuint      width;      // in texels
+    GLuint      height;
+    GLuint      pbo[UPLOAD_PBO_COUNT];
+    GLuint      pboSize;
+    int         pboIndex;
+    uint8_t     *staging;   // rows repacked without pitch, only when GL can't skip the pitch
+    // statistics
+    uint64_t    uploadBytes;
+    uint64_t    uploadTime; // us
+    int         uploadCount;
+} StreamTexture;
+static StreamTexture yuv_textures[3];
+static int has_unpack_subimage = -1;
+static int color_bt709 = 0;
+static int color_full_range = 0;
+static int color_space_dirty = 0;
+static DrawOptions draw_options = { 0, -1, 0 };
+static int offscreen = 0;
+
+#define READBACK_PBO_COUNT 2
+#define READBACK_MAX_RUNGS 8
+// one output size of the readback ladder
+typedef struct {
+    GLuint      fbo;
+    GLuint      tex;        // rgba color attachment, the source of the next (smaller) rung
+    int         width;
+    int         height;
+    int         index;      // in the sizes of setVideoReadback()
+    GLuint      pbo[READBACK_PBO_COUNT];
+} ReadbackRung;
+
+// frames drawn into a ladder of fbos, largest first, each rung downscaled (bilinear) from the one before so
+// the upload and yuv->rgb conversion happen once. The rungs are read back through a ring of pixel pack buffers
+// when gles3 is available, a read is mapped READBACK_PBO_COUNT frames later so glReadPixels doesn't wait for the gpu
+typedef struct {
+    ReadbackRung rungs[READBACK_MAX_RUNGS];
+    int         rungCount;
+    int         order[READBACK_MAX_RUNGS];  // rung of each size index, the callback gets them in that order
+    GLsync      fences[READBACK_PBO_COUNT];
+    void        *tags[READBACK_PBO_COUNT];
+    int         head;       // oldest read in flight
+    int         pending;
+    uint8_t     *rgba;      // gles2: synchronous glReadPixels
+    uint8_t     *rgb;       // packed rgb passed to the callback
+    VideoReadbackCallback callback;
+    void        *opaque;
+    // statistics
+    int         count;
+    uint64_t    startTime;  // us
+    uint64_t    endTime;
+    uint64_t    waitTime;   // fence wait and map
+} ReadbackTarget;
+static ReadbackTarget readback;
+
+#define MOSAIC_MAX_TILES 64
+// video wall: a frame is converted and scaled into its tile's cell of one rgba mosaic fbo when it arrives,
+// presenting draws the mosaic as a single quad whatever the number of tiles
+typedef struct {
+    StreamTexture planes[3];    // raw frames of the tile
+    int         frames;
+} MosaicTile;
+typedef struct {
+    int         cols;
+    int         rows;
+    int         width;          // of the mosaic and the window
+    int         height;
+    GLuint      fbo;
+    GLuint      tex;
+    MosaicTile  *tiles;
+    // statistics
+    int         updates;
+    uint64_t    updateTime;     // us, upload and draw into the cell
+    int         presents;
+    uint64_t    presentTime;
+} Mosaic;
+static Mosaic mosaic;
+
+#define EGL_IMAGE_CACHE_SIZE 32     // per stream, above the surface pool of one decoder
+#define EGL_IMAGE_FOURCC_XRGB YUV_FOURCC('X', 'R', '2', '4')
+// the decoder recycles a small set of surfaces, keep their EGLImage/texture for reuse
+typedef struct {
+    uintptr_t   handle;     // drm name or dma_buf fd
+    int         type;       // 1: drm name, 2: dma_buf
+    uint32_t    width;
+    uint32_t    height;
+    uint32_t    pitch;
+    uint32_t    fourcc;
+    EGLImageKHR image;
+    GLuint      tex;
+    GLenum      target;
+    uint64_t    lastUse;
+} EglImageCacheEntry;
+// each stream has its own decoder: its surfaces are evicted, reallocated and released independently
+typedef struct {
+    int         stream;     // setVideoStream()
+    int         count;
+    EglImageCacheEntry entries[EGL_IMAGE_CACHE_SIZE];
+} EglImageCache;
+static EglImageCache *egl_image_caches = NULL;  // one per stream with imported handles, dense
+static int egl_image_cache_streams = 0;
+static int egl_image_stream = 0;
+static uint64_t egl_image_cache_clock = 0;
+static int egl_image_cache_hits = 0;
+static int egl_image_cache_misses = 0;
+
 #define EGL_CHECK_RESULT_RET(result, promptStr, ret) do {   \
     if (result != EGL_TRUE) {                               \
         ERROR("%s failed", promptStr);                      \
@@ -46,16 +161,160 @@ static Window x11_window = 0;
     }                                                           \
 } while(0)
 
-static GLuint
-createLumaTexture(GLubyte *pixels, GLuint width, GLuint height)
+static uint64_t
+getTimeUs()
 {
-    GLuint textureId;
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
 
-    glGenTextures(1, &textureId );
-    glBindTexture(GL_TEXTURE_2D, textureId);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width/4, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+static void
+releaseStreamTexture(StreamTexture *st)
+{
+    if (st->tex)
+        glDeleteTextures(1, &st->tex);
+    if (st->pboSize)
+        glDeleteBuffers(UPLOAD_PBO_COUNT, st->pbo);
+    free(st->staging);
+    st->tex = 0;
+    st->width = 0;
+    st->height = 0;
+    st->pboSize = 0;
+    st->staging = NULL;
+    st->uploadBytes = 0;
+    st->uploadTime = 0;
+    st->uploadCount = 0;
+}
 
-    return textureId;
+// (re)allocate texture storage only when the resolution changes
+static int
+allocStreamTexture(StreamTexture *st, GLenum format, GLuint bpp, GLuint width, GLuint height, GLuint pitch)
+{
+    uint64_t uploadBytes, uploadTime;
+    int uploadCount;
+
+    if (st->tex && st->width == width && st->height == height)
+        return 0;
+
+    // a resolution change keeps counting, only deinit_egl() starts over
+    uploadBytes = st->uploadBytes;
+    uploadTime = st->uploadTime;
+    uploadCount = st->uploadCount;
+    releaseStreamTexture(st);
+    st->uploadBytes = uploadBytes;
+    st->uploadTime = uploadTime;
+    st->uploadCount = uploadCount;
+    glGenTextures(1, &st->tex);
+    glBindTexture(GL_TEXTURE_2D, st->tex);
+    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    st->width = width;
+    st->height = height;
+
+    if (egl_context->glesVersion >= 3) {
+        int i;
+        st->pboSize = (pitch > width * bpp ? pitch : width * bpp) * height;
+        glGenBuffers(UPLOAD_PBO_COUNT, st->pbo);
+        for (i = 0; i < UPLOAD_PBO_COUNT; i++) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, st->pbo[i]);
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, st->pboSize, NULL, GL_STREAM_DRAW);
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        st->pboIndex = 0;
+    }
+    DEBUG("stream texture %dx%d allocated, pbo size: %d\n", width, height, st->pboSize);
+
+    return glGetError() == GL_NO_ERROR ? 0 : -1;
+}
+
+static void
+copyRows(uint8_t *dst, const uint8_t *src, GLuint rowBytes, GLuint height, GLuint pitch)
+{
+    GLuint row;
+
+    if (pitch == rowBytes) {
+        memcpy(dst, src, rowBytes * height);
+        return;
+    }
+    for (row = 0; row < height; row++)
+        memcpy(dst + row * rowBytes, src + row * pitch, rowBytes);
+}
+
+// upload one plane (pitch in bytes) to the stream texture
+static int
+uploadStreamTexture(StreamTexture *st, GLenum format, GLuint bpp, const uint8_t *pixels, GLuint width, GLuint height, GLuint pitch)
+{
+    GLuint rowBytes = width * bpp;
+    uint64_t start = getTimeUs();
+    // GL_UNPACK_ROW_LENGTH is core in gles3 and the same enum as GL_UNPACK_ROW_LENGTH_EXT
+    int useRowLength = pitch != rowBytes && !(pitch % bpp) && (egl_context->glesVersion >= 3 || has_unpack_subimage);
+    const void *data = pixels;
+
+    if (allocStreamTexture(st, format, bpp, width, height, pitch) < 0) {
+        ERROR("fail to allocate stream texture %dx%d\n", width, height);
+        return -1;
+    }
+
+    glBindTexture(GL_TEXTURE_2D, st->tex);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (useRowLength)
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, pitch / bpp);
+
+    if (st->pboSize) {
+        // rotate through the pbo ring, GL may still read the previous ones
+        uint8_t *ptr;
+        GLuint size = useRowLength ? pitch * (height - 1) + rowBytes : rowBytes * height;
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, st->pbo[st->pboIndex]);
+        ptr = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (!ptr) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            ERROR("fail to map pixel unpack buffer\n");
+            return -1;
+        }
+        if (useRowLength)
+            memcpy(ptr, pixels, size);
+        else
+            copyRows(ptr, pixels, rowBytes, height, pitch);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        data = NULL; // offset in the bound pbo
+        st->pboIndex = (st->pboIndex + 1) % UPLOAD_PBO_COUNT;
+    } else if (pitch != rowBytes && !useRowLength) {
+        if (!st->staging)
+            st->staging = malloc(rowBytes * height);
+        if (!st->staging)
+            return -1;
+        copyRows(st->staging, pixels, rowBytes, height, pitch);
+        data = st->staging;
+    }
+
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, format, GL_UNSIGNED_BYTE, data);
+
+    if (st->pboSize)
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    if (useRowLength)
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    st->uploadBytes += rowBytes * height;
+    st->uploadTime += getTimeUs() - start;
+    st->uploadCount++;
+    return 0;
+}
+
+static void
+printStreamTextureStatistics(const char *name, StreamTexture *st)
+{
+    if (!st->uploadCount)
+        return;
+    PRINTF("%s texture upload (%s): %d frames, %.1f MB, %.1f MB/s\n", name,
+        st->pboSize ? "pbo" : (has_unpack_subimage ? "unpack_subimage" : "client memory"),
+        st->uploadCount, st->uploadBytes / 1000000.0,
+        st->uploadTime ? st->uploadBytes / (double)st->uploadTime : 0.0);
 }
 
 static GLuint
@@ -76,6 +335,141 @@ createTextureFromEgl(EGLImageKHR egl_image, GLenum target, GLuint width, GLuint
     return textureId;
 }
 
+static void
+releaseEglImageCacheEntry(EglImageCacheEntry *entry)
+{
+    glDeleteTextures(1, &entry->tex);
+    eglDestroyImageKHR(egl_context->eglContext.display, entry->image);
+    memset(entry, 0, sizeof(*entry));
+}
+
+static void
+releaseEglImageCache(EglImageCache *cache)
+{
+    int i;
+
+    for (i = 0; i < cache->count; i++)
+        releaseEglImageCacheEntry(&cache->entries[i]);
+    cache->count = 0;
+}
+
+void setVideoStream(int stream)
+{
+    egl_image_stream = stream;
+}
+
+void flushVideoImageCache(int stream)
+{
+    int i;
+
+    if (!egl_context)
+        return;
+    if (stream < 0) {
+        for (i = 0; i < egl_image_cache_streams; i++)
+            releaseEglImageCache(&egl_image_caches[i]);
+        free(egl_image_caches);
+        egl_image_caches = NULL;
+        egl_image_cache_streams = 0;
+        return;
+    }
+    for (i = 0; i < egl_image_cache_streams; i++) {
+        if (egl_image_caches[i].stream == stream) {
+            releaseEglImageCache(&egl_image_caches[i]);
+            egl_image_caches[i] = egl_image_caches[--egl_image_cache_streams];
+            return;
+        }
+    }
+}
+
+void getVideoImageCacheStats(int *hits, int *misses)
+{
+    if (hits)
+        *hits = egl_image_cache_hits;
+    if (misses)
+        *misses = egl_image_cache_misses;
+}
+
+// the cache of the stream, added when its first handle is imported
+static EglImageCache*
+getEglImageCache(int stream)
+{
+    EglImageCache *caches;
+    int i;
+
+    for (i = 0; i < egl_image_cache_streams; i++) {
+        if (egl_image_caches[i].stream == stream)
+            return &egl_image_caches[i];
+    }
+    caches = realloc(egl_image_caches, (egl_image_cache_streams + 1) * sizeof(EglImageCache));
+    if (!caches)
+        return NULL;
+    egl_image_caches = caches;
+    memset(&caches[egl_image_cache_streams], 0, sizeof(EglImageCache));
+    caches[egl_image_cache_streams].stream = stream;
+    return &caches[egl_image_cache_streams++];
+}
+
+// return the cached texture of the handle, import it as EGLImage when it isn't cached yet
+static EglImageCacheEntry*
+getEglImageCacheEntry(uintptr_t handle, int type, uint32_t width, uint32_t height, uint32_t pitch)
+{
+    EglImageCache *cache = getEglImageCache(egl_image_stream);
+    EglImageCacheEntry *entry = NULL;
+    GLenum target = type == 2 ? GL_TEXTURE_EXTERNAL_OES : GL_TEXTURE_2D;
+    int i;
+
+    if (!cache)
+        return NULL;
+    // the stream's surfaces are reallocated on resolution change, drop all of them
+    if (cache->count && (cache->entries[0].width != width || cache->entries[0].height != height))
+        releaseEglImageCache(cache);
+
+    for (i = 0; i < cache->count; i++) {
+        entry = &cache->entries[i];
+        if (entry->handle == handle && entry->type == type && entry->pitch == pitch
+            && entry->fourcc == EGL_IMAGE_FOURCC_XRGB) {
+            entry->lastUse = ++egl_image_cache_clock;
+            egl_image_cache_hits++;
+            return entry;
+        }
+    }
+
+    egl_image_cache_misses++;
+    if (cache->count < EGL_IMAGE_CACHE_SIZE) {
+        entry = &cache->entries[cache->count++];
+    } else { // evict the least recently used one of the stream
+        entry = &cache->entries[0];
+        for (i = 1; i < EGL_IMAGE_CACHE_SIZE; i++) {
+            if (cache->entries[i].lastUse < entry->lastUse)
+                entry = &cache->entries[i];
+        }
+        releaseEglImageCacheEntry(entry);
+    }
+
+    entry->image = createEglImageFromHandle(egl_context->eglContext.display, egl_context->eglContext.context,
+       target == GL_TEXTURE_EXTERNAL_OES, handle, width, height, pitch);
+    if (entry->image == EGL_NO_IMAGE_KHR) {
+        ERROR("fail to create EGLImage from handle %p\n", (void*)handle);
+        // keep the cache dense
+        *entry = cache->entries[--cache->count];
+        memset(&cache->entries[cache->count], 0, sizeof(*entry));
+        return NULL;
+    }
+    entry->tex = createTextureFromEgl(entry->image, target, width, height, pitch);
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    entry->handle = handle;
+    entry->type = type;
+    entry->width = width;
+    entry->height = height;
+    entry->pitch = pitch;
+    entry->fourcc = EGL_IMAGE_FOURCC_XRGB;
+    entry->target = target;
+    entry->lastUse = ++egl_image_cache_clock;
+
+    return entry;
+}
+
 // test use only
 static GLuint
 createTestTexture( )
@@ -97,84 +491,692 @@ createTestTexture( )
     return textureId;
 }
 
-int drawVideo(uintptr_t handle, int type, uint32_t width, uint32_t height, uint32_t pitch)
+void setVideoDrawOptions(int fit, int swapInterval, int tripleBuffer)
 {
-    GLuint tex = 0;
-    EGLImageKHR egl_image = EGL_NO_IMAGE_KHR;
-    GLenum target = GL_TEXTURE_2D;
+    draw_options.fit = fit;
+    draw_options.swapInterval = swapInterval;
+    draw_options.tripleBuffer = tripleBuffer;
+}
 
-    DEBUG("handle=%p, width=%d, height=%d, pitch=%d\n", (void*)handle, width, height, pitch);
-    if (!egl_context)
-        init_egl(width, height, type == 2);
+int setVideoReadback(const int *sizes, int count, VideoReadbackCallback callback, void *opaque)
+{
+    ReadbackTarget *rt = &readback;
+    ReadbackRung rung;
+    int i, j;
 
-    switch (type) {
-    case 0:
-        // HACK, simple draw luma as RGBX
-        tex = createLumaTexture((uint8_t*)handle, width, height);
-        break;
-    case 1:
-    case 2:
-        if (type == 2)
-            target = GL_TEXTURE_EXTERNAL_OES;
+    if (count > READBACK_MAX_RUNGS) {
+        ERROR("at most %d readback sizes are supported\n", READBACK_MAX_RUNGS);
+        return -1;
+    }
+    memset(rt->rungs, 0, sizeof(rt->rungs));
+    for (i = 0; i < count; i++) {
+        rt->rungs[i].width = sizes[2 * i];
+        rt->rungs[i].height = sizes[2 * i + 1];
+        rt->rungs[i].index = i;
+    }
+    // largest first: each rung is a downscale of the previous one
+    for (i = 1; i < count; i++) {
+        rung = rt->rungs[i];
+        for (j = i; j > 0 && rt->rungs[j - 1].width * rt->rungs[j - 1].height < rung.width * rung.height; j--)
+            rt->rungs[j] = rt->rungs[j - 1];
+        rt->rungs[j] = rung;
+    }
+    for (i = 0; i < count; i++)
+        rt->order[rt->rungs[i].index] = i;
+    rt->rungCount = count;
+    rt->callback = callback;
+    rt->opaque = opaque;
+
+    return 0;
+}
+
+static int
+initReadbackRung(ReadbackRung *rung)
+{
+    int i;
 
-        egl_image = createEglImageFromHandle(egl_context->eglContext.display, egl_context->eglContext.context,
-           target == GL_TEXTURE_EXTERNAL_OES, handle, width, height, pitch);
+    glGenTextures(1, &rung->tex);
+    glBindTexture(GL_TEXTURE_2D, rung->tex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, rung->width, rung->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    // sampled by the next rung
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glGenFramebuffers(1, &rung->fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, rung->fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, rung->tex, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        ERROR("readback framebuffer %dx%d isn't complete\n", rung->width, rung->height);
+        return -1;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-        if (egl_image != EGL_NO_IMAGE_KHR) {
-            tex = createTextureFromEgl(egl_image, target, width, height, pitch);
-        } else {
-            ERROR("fail to create EGLImage from dma_buf");
+    if (egl_context->glesVersion >= 3) {
+        glGenBuffers(READBACK_PBO_COUNT, rung->pbo);
+        for (i = 0; i < READBACK_PBO_COUNT; i++) {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, rung->pbo[i]);
+            glBufferData(GL_PIXEL_PACK_BUFFER, rung->width * rung->height * 4, NULL, GL_STREAM_READ);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+    DEBUG("readback rung %dx%d, pbo: %d\n", rung->width, rung->height, egl_context->glesVersion >= 3);
+
+    return glGetError() == GL_NO_ERROR ? 0 : -1;
+}
+
+static int
+initReadbackTarget(ReadbackTarget *rt)
+{
+    int i;
+
+    if (!rt->rungCount) {
+        ERROR("no readback size is set\n");
+        return -1;
+    }
+    for (i = 0; i < rt->rungCount; i++) {
+        if (initReadbackRung(&rt->rungs[i]) < 0)
             return -1;
+    }
+    // the first rung is the largest
+    if (egl_context->glesVersion < 3)
+        rt->rgba = malloc(rt->rungs[0].width * rt->rungs[0].height * 4);
+    rt->rgb = malloc(rt->rungs[0].width * rt->rungs[0].height * 3);
+    if (!rt->rgb || (egl_context->glesVersion < 3 && !rt->rgba))
+        return -1;
+
+    return 0;
+}
+
+static void
+deliverReadback(ReadbackTarget *rt, ReadbackRung *rung, const uint8_t *rgba, void *tag)
+{
+    const uint8_t *src = rgba;
+    uint8_t *dst = rt->rgb;
+    int i, pixels = rung->width * rung->height;
+
+    for (i = 0; i < pixels; i++) {
+        dst[0] = src[0];
+        dst[1] = src[1];
+        dst[2] = src[2];
+        src += 4;
+        dst += 3;
+    }
+    if (rt->callback)
+        rt->callback(rt->opaque, tag, rung->index, rt->rgb, rung->width, rung->height);
+}
+
+// map the oldest frame's reads, its fence was queued READBACK_PBO_COUNT frames ago and has usually passed
+static int
+completeReadback(ReadbackTarget *rt)
+{
+    int slot = rt->head;
+    uint64_t start = getTimeUs();
+    const uint8_t *rgba;
+    ReadbackRung *rung;
+    int i, ret = 0;
+
+    glClientWaitSync(rt->fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+    glDeleteSync(rt->fences[slot]);
+    rt->fences[slot] = 0;
+    rt->head = (rt->head + 1) % READBACK_PBO_COUNT;
+    rt->pending--;
+    rt->waitTime += getTimeUs() - start;
+
+    for (i = 0; i < rt->rungCount; i++) {
+        rung = &rt->rungs[rt->order[i]];
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, rung->pbo[slot]);
+        rgba = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, rung->width * rung->height * 4, GL_MAP_READ_BIT);
+        if (!rgba) {
+            ERROR("fail to map pixel pack buffer\n");
+            ret = -1;
+            continue;
+        }
+        deliverReadback(rt, rung, rgba, rt->tags[slot]);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    rt->count++;
+    rt->endTime = getTimeUs();
+
+    return ret;
+}
+
+// all rungs are drawn and their reads queued in one submission
+static int
+readbackTextures(ReadbackTarget *rt, GLenum target, GLuint *textureIds, int texCount, void *tag)
+{
+    ReadbackRung *rung;
+    int i, slot, ret = 0;
+
+    if (!rt->rungs[0].fbo && initReadbackTarget(rt) < 0)
+        return -1;
+    if (!rt->startTime)
+        rt->startTime = getTimeUs();
+    // free a pack buffer for this frame
+    if (rt->pending == READBACK_PBO_COUNT)
+        ret = completeReadback(rt);
+
+    slot = (rt->head + rt->pending) % READBACK_PBO_COUNT;
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    for (i = 0; i < rt->rungCount; i++) {
+        rung = &rt->rungs[i];
+        glBindFramebuffer(GL_FRAMEBUFFER, rung->fbo);
+        if (!i)
+            drawTexturesOffscreen(egl_context, target, textureIds, texCount, 0, 0, rung->width, rung->height);
+        else
+            drawTextureOffscreenRgb(egl_context, rt->rungs[i - 1].tex, 0, 0, rung->width, rung->height);
+        if (rt->rgba)
+            continue;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, rung->pbo[slot]);
+        glReadPixels(0, 0, rung->width, rung->height, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+
+    if (!rt->rgba) {
+        rt->fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        rt->tags[slot] = tag;
+        rt->pending++;
+        // start the gpu on it, the fence is waited for frames later
+        glFlush();
+    } else {
+        uint64_t start = getTimeUs();
+        for (i = 0; i < rt->rungCount; i++) {
+            rung = &rt->rungs[rt->order[i]];
+            glBindFramebuffer(GL_FRAMEBUFFER, rung->fbo);
+            glReadPixels(0, 0, rung->width, rung->height, GL_RGBA, GL_UNSIGNED_BYTE, rt->rgba);
+            deliverReadback(rt, rung, rt->rgba, tag);
         }
+        rt->waitTime += getTimeUs() - start;
+        rt->count++;
+        rt->endTime = getTimeUs();
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    return ret;
+}
+
+void flushVideoReadback()
+{
+    while (readback.pending)
+        completeReadback(&readback);
+}
+
+static void
+releaseReadbackTarget(ReadbackTarget *rt)
+{
+    ReadbackRung *rung;
+    int i;
+
+    flushVideoReadback();
+    if (rt->count) {
+        uint64_t elapsed = rt->endTime - rt->startTime;
+        PRINTF("readback (%s): %d frames, %d sizes from %dx%d, %.1f fps, wait %.2f ms per frame\n",
+            rt->rgba ? "glReadPixels" : "pbo", rt->count, rt->rungCount, rt->rungs[0].width, rt->rungs[0].height,
+            elapsed ? rt->count * 1000000.0 / elapsed : 0.0, rt->waitTime / 1000.0 / rt->count);
+    }
+    for (i = 0; i < rt->rungCount; i++) {
+        rung = &rt->rungs[i];
+        if (!rung->fbo)
+            continue;
+        if (!rt->rgba)
+            glDeleteBuffers(READBACK_PBO_COUNT, rung->pbo);
+        glDeleteFramebuffers(1, &rung->fbo);
+        glDeleteTextures(1, &rung->tex);
+        memset(rung->pbo, 0, sizeof(rung->pbo));
+        rung->fbo = 0;
+        rung->tex = 0;
+    }
+    free(rt->rgba);
+    free(rt->rgb);
+    rt->rgba = NULL;
+    rt->rgb = NULL;
+    rt->count = 0;
+    rt->startTime = 0;
+    rt->endTime = 0;
+    rt->waitTime = 0;
+}
+
+void setVideoOffscreen(int enable)
+{
+    offscreen = enable;
+}
+
+void setVideoColorSpace(int isBT709, int isFullRange)
+{
+    if (color_bt709 == !!isBT709 && color_full_range == !!isFullRange)
+        return;
+    color_bt709 = !!isBT709;
+    color_full_range = !!isFullRange;
+    color_space_dirty = 1;
+}
+
+// upload the planes to the stream textures, returns the texture count
+static int
+uploadVideoRaw(StreamTexture *textures, uint8_t *planes[3], uint32_t pitches[3], uint32_t fourcc, uint32_t width, uint32_t height, GLuint tex[3])
+{
+    GLuint chromaWidth = (width + 1) / 2, chromaHeight = (height + 1) / 2;
+    int texCount = fourcc == YUV_FOURCC_NV12 ? 2 : 3;
+    int i, ret = 0;
+
+    DEBUG("planes=%p %p %p, fourcc=%.4s, width=%d, height=%d\n", planes[0], planes[1], planes[2], (char*)&fourcc, width, height);
+    if (fourcc != YUV_FOURCC_I420 && fourcc != YUV_FOURCC_NV12) {
+        ERROR("unsupported raw video format: %.4s\n", (char*)&fourcc);
+        return -1;
+    }
+    if (!egl_context) {
+        init_egl(width, height, fourcc, 0);
+        color_space_dirty = 1;
+    }
+    if (!egl_context)
+        return -1;
+    if (egl_context->glProgram->texCount != texCount) {
+        ERROR("raw video format changed to %.4s, it isn't supported\n", (char*)&fourcc);
+        return -1;
+    }
+
+    ret |= uploadStreamTexture(&textures[0], GL_LUMINANCE, 1, planes[0], width, height, pitches[0]);
+    if (fourcc == YUV_FOURCC_NV12) {
+        ret |= uploadStreamTexture(&textures[1], GL_LUMINANCE_ALPHA, 2, planes[1], chromaWidth, chromaHeight, pitches[1]);
+    } else {
+        ret |= uploadStreamTexture(&textures[1], GL_LUMINANCE, 1, planes[1], chromaWidth, chromaHeight, pitches[1]);
+        ret |= uploadStreamTexture(&textures[2], GL_LUMINANCE, 1, planes[2], chromaWidth, chromaHeight, pitches[2]);
+    }
+    if (ret < 0)
+        return -1;
+
+    if (color_space_dirty) {
+        setYuvColorSpace(egl_context, color_bt709, color_full_range);
+        color_space_dirty = 0;
+    }
+
+    for (i = 0; i < texCount; i++)
+        tex[i] = textures[i].tex;
+    return texCount;
+}
+
+int drawVideoRaw(uint8_t *planes[3], uint32_t pitches[3], uint32_t fourcc, uint32_t width, uint32_t height)
+{
+    GLuint tex[3];
+    int texCount = uploadVideoRaw(yuv_textures, planes, pitches, fourcc, width, height, tex);
+
+    if (texCount < 0)
+        return -1;
+    setDrawVideoSize(egl_context, width, height);
+    return drawTextures(egl_context, GL_TEXTURE_2D, tex, texCount);
+}
+
+int readbackVideoRaw(uint8_t *planes[3], uint32_t pitches[3], uint32_t fourcc, uint32_t width, uint32_t height, void *tag)
+{
+    GLuint tex[3];
+    int texCount = uploadVideoRaw(yuv_textures, planes, pitches, fourcc, width, height, tex);
+
+    if (texCount < 0)
+        return -1;
+    return readbackTextures(&readback, GL_TEXTURE_2D, tex, texCount, tag);
+}
+
+// the texture of a drm name/dma_buf handle, NULL on failure
+static EglImageCacheEntry*
+importVideo(uintptr_t handle, int type, uint32_t width, uint32_t height, uint32_t pitch)
+{
+    EglImageCacheEntry *entry = NULL;
+
+    if (!egl_context)
+        init_egl(width, height, 0, type == 2);
+    if (!egl_context)
+        return NULL;
+
+    switch (type) {
+    case 1:
+    case 2:
+        entry = getEglImageCacheEntry(handle, type, width, height, pitch);
         break;
     default:
         ERROR("unknonw video buffer type\n");
+        break;
+    }
+
+    return entry;
+}
+
+// type 0: contiguous I420 buffer, chroma planes follow the luma plane
+static void
+splitVideoI420(uintptr_t handle, uint32_t height, uint32_t pitch, uint32_t width, uint8_t *planes[3], uint32_t pitches[3])
+{
+    pitches[0] = pitch ? pitch : width;
+    pitches[1] = pitches[2] = (pitches[0] + 1) / 2;
+    planes[0] = (uint8_t*)handle;
+    planes[1] = planes[0] + pitches[0] * height;
+    planes[2] = planes[1] + pitches[1] * ((height + 1) / 2);
+}
+
+int readbackVideo(uintptr_t handle, int type, uint32_t width, uint32_t height, uint32_t pitch, void *tag)
+{
+    EglImageCacheEntry *entry;
+
+    if (type == 0) {
+        uint8_t *planes[3];
+        uint32_t pitches[3];
+
+        splitVideoI420(handle, height, pitch, width, planes, pitches);
+        return readbackVideoRaw(planes, pitches, YUV_FOURCC_I420, width, height, tag);
+    }
+
+    entry = importVideo(handle, type, width, height, pitch);
+    if (!entry)
+        return -1;
+    return readbackTextures(&readback, entry->target, &entry->tex, 1, tag);
+}
+
+int setVideoMosaic(int cols, int rows, int width, int height)
+{
+    if (cols <= 0 || rows <= 0 || cols * rows > MOSAIC_MAX_TILES || width < cols || height < rows) {
+        ERROR("invalid mosaic %dx%d of %dx%d, at most %d tiles\n", cols, rows, width, height, MOSAIC_MAX_TILES);
         return -1;
     }
-    // GLuint tex = createTestTexture();
-    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    mosaic.cols = cols;
+    mosaic.rows = rows;
+    mosaic.width = width;
+    mosaic.height = height;
 
-    drawTextures(egl_context, target, &tex, 1);
-    glDeleteTextures(1, &tex);
-    if (egl_image != EGL_NO_IMAGE_KHR) {
-        eglDestroyImageKHR(egl_context->eglContext.display, egl_image);
+    return 0;
+}
+
+static int
+initMosaic(Mosaic *m)
+{
+    m->tiles = calloc(m->cols * m->rows, sizeof(MosaicTile));
+    if (!m->tiles)
+        return -1;
+    glGenTextures(1, &m->tex);
+    glBindTexture(GL_TEXTURE_2D, m->tex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, m->width, m->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glGenFramebuffers(1, &m->fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, m->fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m->tex, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        ERROR("mosaic framebuffer %dx%d isn't complete\n", m->width, m->height);
+        return -1;
     }
+    // tiles without frames and the bars around tiles stay black
+    glClearColor(0.0, 0.0, 0.0, 1.0);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glClearColor(0.0, 0.0, 0.5, 0.0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    DEBUG("mosaic %dx%d tiles of %dx%d\n", m->cols, m->rows, m->width / m->cols, m->height / m->rows);
+
+    return glGetError() == GL_NO_ERROR ? 0 : -1;
+}
+
+// draw the tile's textures into its cell keeping the video aspect ratio, row 0 of the mosaic is its top
+static int
+drawMosaicTile(Mosaic *m, int tile, GLenum target, GLuint *textureIds, int texCount, uint32_t width, uint32_t height)
+{
+    int cellWidth = m->width / m->cols, cellHeight = m->height / m->rows;
+    int x = (tile % m->cols) * cellWidth, y = (tile / m->cols) * cellHeight;
+    int w = cellWidth, h = cellHeight;
+
+    if ((int64_t)width * cellHeight > (int64_t)cellWidth * height)
+        h = (int64_t)cellWidth * height / width;
+    else
+        w = (int64_t)cellHeight * width / height;
+    x += (cellWidth - w) / 2;
+    y += (cellHeight - h) / 2;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m->fbo);
+    drawTexturesOffscreen(egl_context, target, textureIds, texCount, x, y, w, h);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    m->tiles[tile].frames++;
 
     return 0;
 }
 
+// the mosaic is created with the egl context, on the first frame
+static int
+checkMosaicTile(int tile)
+{
+    if (!mosaic.cols) {
+        ERROR("mosaic isn't set\n");
+        return -1;
+    }
+    if (tile < 0 || tile >= mosaic.cols * mosaic.rows) {
+        ERROR("mosaic tile %d out of range\n", tile);
+        return -1;
+    }
+    return 0;
+}
+
+int drawVideoTileRaw(int tile, uint8_t *planes[3], uint32_t pitches[3], uint32_t fourcc, uint32_t width, uint32_t height)
+{
+    GLuint tex[3];
+    int texCount;
+    uint64_t start = getTimeUs();
+
+    if (checkMosaicTile(tile) < 0)
+        return -1;
+    if (!egl_context) {
+        init_egl(width, height, fourcc, 0);
+        color_space_dirty = 1;
+    }
+    if (!egl_context || !mosaic.tiles)
+        return -1;
+    texCount = uploadVideoRaw(mosaic.tiles[tile].planes, planes, pitches, fourcc, width, height, tex);
+    if (texCount < 0)
+        return -1;
+    drawMosaicTile(&mosaic, tile, GL_TEXTURE_2D, tex, texCount, width, height);
+    mosaic.updates++;
+    mosaic.updateTime += getTimeUs() - start;
+
+    return 0;
+}
+
+int drawVideoTile(int tile, uintptr_t handle, int type, uint32_t width, uint32_t height, uint32_t pitch)
+{
+    EglImageCacheEntry *entry;
+    uint64_t start = getTimeUs();
+
+    if (type == 0) {
+        uint8_t *planes[3];
+        uint32_t pitches[3];
+
+        splitVideoI420(handle, height, pitch, width, planes, pitches);
+        return drawVideoTileRaw(tile, planes, pitches, YUV_FOURCC_I420, width, height);
+    }
+
+    if (checkMosaicTile(tile) < 0)
+        return -1;
+    entry = importVideo(handle, type, width, height, pitch);
+    if (!entry || !mosaic.tiles)
+        return -1;
+    drawMosaicTile(&mosaic, tile, entry->target, &entry->tex, 1, width, height);
+    mosaic.updates++;
+    mosaic.updateTime += getTimeUs() - start;
+
+    return 0;
+}
+
+int presentVideoMosaic()
+{
+    uint64_t start = getTimeUs();
+    int ret;
+
+    if (!egl_context || !mosaic.tiles)
+        return 0;
+    ret = presentTextureRgb(egl_context, mosaic.tex);
+    mosaic.presents++;
+    mosaic.presentTime += getTimeUs() - start;
+
+    return ret;
+}
+
+static void
+releaseMosaic(Mosaic *m)
+{
+    int i, j;
+
+    if (!m->tiles)
+        return;
+    if (m->updates)
+        PRINTF("mosaic %dx%d: %d tile updates, %.3f ms each; %d presents, %.3f ms each\n", m->cols, m->rows,
+            m->updates, m->updateTime / 1000.0 / m->updates,
+            m->presents, m->presents ? m->presentTime / 1000.0 / m->presents : 0.0);
+    for (i = 0; i < m->cols * m->rows; i++) {
+        for (j = 0; j < 3; j++)
+            releaseStreamTexture(&m->tiles[i].planes[j]);
+    }
+    glDeleteFramebuffers(1, &m->fbo);
+    glDeleteTextures(1, &m->tex);
+    free(m->tiles);
+    m->tiles = NULL;
+    m->fbo = 0;
+    m->tex = 0;
+}
 
-static int init_egl(uint32_t width, uint32_t height, int is_dmabuf)
+int drawVideo(uintptr_t handle, int type, uint32_t width, uint32_t height, uint32_t pitch)
+{
+    EglImageCacheEntry *entry = NULL;
+
+    DEBUG("handle=%p, width=%d, height=%d, pitch=%d\n", (void*)handle, width, height, pitch);
+    if (type == 0) {
+        uint8_t *planes[3];
+        uint32_t pitches[3];
+
+        splitVideoI420(handle, height, pitch, width, planes, pitches);
+        return drawVideoRaw(planes, pitches, YUV_FOURCC_I420, width, height);
+    }
+
+    entry = importVideo(handle, type, width, height, pitch);
+    if (!entry)
+        return -1;
+    // GLuint tex = createTestTexture();
+
+    setDrawVideoSize(egl_context, width, height);
+    drawTextures(egl_context, entry->target, &entry->tex, 1);
+
+    return 0;
+}
+
+
+// X connection (window mode), EGL display, context and the video program, no surface yet
+static int prepare_egl(uint32_t fourcc, int is_dmabuf)
+{
+    if (offscreen) {
+        DEBUG("setup offscreen egl environments\n");
+        prepared_context = eglPrepare(NULL, fourcc, is_dmabuf);
+    } else {
+        DEBUG("setup X connection and egl environments\n");
+        XInitThreads();
+        x11_display = XOpenDisplay(NULL);
+        CHECK_HANDLE_RET(x11_display, NULL, "XOpenDisplay", -1);
+        prepared_context = eglPrepare(x11_display, fourcc, is_dmabuf);
+    }
+    CHECK_HANDLE_RET(prepared_context, NULL, "eglPrepare", -1);
+    return 0;
+}
+
+int prepareVideoRender(int type, uint32_t fourcc)
 {
-    DEBUG("setup X connection and egl environments\n");
+    if (egl_context || prepared_context)
+        return 0;
+    return prepare_egl(type ? 0 : fourcc, type == 2);
+}
 
-    XInitThreads();
-    x11_display = XOpenDisplay(NULL);
-    CHECK_HANDLE_RET(x11_display, NULL, "XOpenDisplay", -1);
+static int init_egl(uint32_t width, uint32_t height, uint32_t fourcc, int is_dmabuf)
+{
+    if (mosaic.cols) {
+        width = mosaic.width;
+        height = mosaic.height;
+    }
+    if (!prepared_context && prepare_egl(fourcc, is_dmabuf) < 0)
+        return -1;
+    if (!offscreen)
+        x11_window = create_x11_window(width, height);
+    if ((!offscreen && !x11_window) || eglAttachSurface(prepared_context, x11_window, width, height) < 0) {
+        ERROR("fail to create %dx%d draw surface\n", width, height);
+        if (x11_window)
+            XDestroyWindow(x11_display, x11_window);
+        x11_window = 0;
+        return -1;
+    }
+    egl_context = prepared_context;
+    prepared_context = NULL;
+    // prepareVideoRender() may have guessed another texture format
+    if (setTextureFormat(egl_context, fourcc, is_dmabuf) < 0)
+        ERROR("fail to create video program for %.4s\n", (char*)&fourcc);
+    if (setDrawOptions(egl_context, &draw_options) < 0)
+        ERROR("fail to set draw options\n");
+    if (has_unpack_subimage < 0) {
+        const char *extensions = (const char*)glGetString(GL_EXTENSIONS);
+        has_unpack_subimage = extensions && strstr(extensions, "GL_EXT_unpack_subimage") != NULL;
+    }
+    if (mosaic.cols && initMosaic(&mosaic) < 0)
+        return -1;
+    return 0;
+}
+
+static Window create_x11_window(uint32_t width, uint32_t height)
+{
     Window x11_root_window = DefaultRootWindow(x11_display);
+    Window window;
 
     // create with video size, simplify it
-    x11_window = XCreateSimpleWindow(x11_display, x11_root_window,
+    window = XCreateSimpleWindow(x11_display, x11_root_window,
         0, 0, width, height, 0, 0, WhitePixel(x11_display, 0));
-    XMapWindow(x11_display, x11_window);
+    XMapWindow(x11_display, window);
     XSync(x11_display, 0);
 
-    egl_context = eglInit(x11_display, x11_window, 0, is_dmabuf);
+    return window;
 }
 int deinit_egl()
 {
+    int i;
+
     DEBUG("deinit_egl ...\n");
-    if (!egl_context)
+    if (prepared_context) {
+        // no frame was drawn
+        eglRelease(prepared_context);
+        prepared_context = NULL;
+    }
+    if (!egl_context) {
+        if (x11_window)
+            XDestroyWindow(x11_display, x11_window);
+        if (x11_display)
+            XCloseDisplay(x11_display);
+        x11_window = 0;
+        x11_display = NULL;
         return 0;
+    }
 
+    releaseReadbackTarget(&readback);
+    releaseMosaic(&mosaic);
+    printStreamTextureStatistics("Y", &yuv_textures[0]);
+    printStreamTextureStatistics("U/UV", &yuv_textures[1]);
+    printStreamTextureStatistics("V", &yuv_textures[2]);
+    for (i = 0; i < 3; i++)
+        releaseStreamTexture(&yuv_textures[i]);
+    if (egl_image_cache_hits + egl_image_cache_misses)
+        PRINTF("EGLImage cache: %d hits, %d misses\n", egl_image_cache_hits, egl_image_cache_misses);
+    egl_image_cache_hits = 0;
+    egl_image_cache_misses = 0;
+    flushVideoImageCache(-1);
     eglRelease(egl_context);
+    // probed again on the next context, it may come from another driver
+    has_unpack_subimage = -1;
     if (x11_window && x11_display) {
         XUnmapWindow(x11_display, x11_window);
         XDestroyWindow(x11_display, x11_window);
     }
-    if (!x11_display)
+    if (x11_display)
         XCloseDisplay(x11_display);
+    x11_window = 0;
+    x11_display = NULL;
 
     egl_context = NULL;
     DEBUG("deinit_egl successfully\n");
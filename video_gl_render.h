@@ -24,28 +24,54 @@
 #define __VIDEO_GL_RENDER_H__
 
 #include <stdint.h>
-#include <stdio.h>
-#include <assert.h>
+#include "player_log.h"
 
-// type 0: raw yuv data, 1: drm name (flink), 2: dma_buf handle
+#ifndef YUV_FOURCC
+#define YUV_FOURCC(ch0, ch1, ch2, ch3) \
+    ((uint32_t)(uint8_t)(ch0) | ((uint32_t)(uint8_t)(ch1) << 8) | \
+    ((uint32_t)(uint8_t)(ch2) << 16) | ((uint32_t)(uint8_t)(ch3) << 24 ))
+#define YUV_FOURCC_I420 YUV_FOURCC('I', '4', '2', '0')
+#define YUV_FOURCC_NV12 YUV_FOURCC('N', 'V', '1', '2')
+#endif
+
+// type 0: contiguous I420 data (pitch: luma pitch in bytes), 1: drm name (flink), 2: dma_buf handle
 int drawVideo(uintptr_t handle, int type, uint32_t width, uint32_t height, uint32_t pitch);
+// raw video frame in system memory, fourcc: YUV_FOURCC_I420 or YUV_FOURCC_NV12; converted to rgb by shader
+int drawVideoRaw(uint8_t *planes[3], uint32_t pitches[3], uint32_t fourcc, uint32_t width, uint32_t height);
+// color space of the raw video frames: BT.601 or BT.709, limited or full range
+void setVideoColorSpace(int isBT709, int isFullRange);
+// before the first frame: fit: retained draw path keeping the video aspect ratio (instead of the zoom demo),
+// swapInterval: 0 doesn't wait for vblank, -1 EGL default; tripleBuffer: two frames queued ahead of the display
+void setVideoDrawOptions(int fit, int swapInterval, int tripleBuffer);
+// thumbnails/previews: each frame is scaled into fbos of the given sizes (count width, height pairs, a bilinear
+// downscale chain from one upload) and read back asynchronously (pixel pack buffers + fences). The callback gets
+// each size in turn (index in sizes) as packed rgb rows, top row first (ready for a jpeg encoder), usually a frame later
+typedef void (*VideoReadbackCallback)(void *opaque, void *tag, int index, const uint8_t *rgb, int width, int height);
+int setVideoReadback(const int *sizes, int count, VideoReadbackCallback callback, void *opaque);
+int readbackVideo(uintptr_t handle, int type, uint32_t width, uint32_t height, uint32_t pitch, void *tag);
+int readbackVideoRaw(uint8_t *planes[3], uint32_t pitches[3], uint32_t fourcc, uint32_t width, uint32_t height, void *tag);
+// deliver the reads still in flight
+void flushVideoReadback();
+// video wall: before the first frame, a cols x rows grid of tiles in a width x height window (at most 64 tiles)
+int setVideoMosaic(int cols, int rows, int width, int height);
+// the frame replaces the tile's picture (scaled to its cell, aspect kept), shown by the next present
+int drawVideoTile(int tile, uintptr_t handle, int type, uint32_t width, uint32_t height, uint32_t pitch);
+int drawVideoTileRaw(int tile, uint8_t *planes[3], uint32_t pitches[3], uint32_t fourcc, uint32_t width, uint32_t height);
+// draw all tiles to the window (one quad) and swap
+int presentVideoMosaic();
+// optional, before the first frame on the render thread: bring up the display, EGL context and video program
+// while the decoder starts, the window/pbuffer follows with the first frame (its size and format win over
+// the guess here); type and fourcc as of drawVideo()/drawVideoRaw()
+int prepareVideoRender(int type, uint32_t fourcc);
+// before the first frame: render to a video sized pbuffer of a surfaceless EGL display instead of an X window
+void setVideoOffscreen(int enable);
+// EGLImage/texture of drm name/dma_buf handles are cached per stream (each has its own decoder surface pool):
+// the stream of the following drawVideo()/drawVideoTile()/readbackVideo() calls, 0 if never set
+void setVideoStream(int stream);
+// flush the stream's images when its decoder (surface pool) is released, -1: all streams
+void flushVideoImageCache(int stream);
+void getVideoImageCacheStats(int *hits, int *misses);
 // int init_egl(uint32_t width, uint32_t height, int is_dmabuf);
 int deinit_egl();
 
-#ifdef PLAYER_DEBUG
-#define DEBUG(format, ...)   printf("  %s, %d, " format, __FILE__, __LINE__, ##__VA_ARGS__)
-#else
-#define DEBUG(...)
-#endif
-#define PRINTF printf
-#define ERROR(format, ...) fprintf(stderr, "!!ERROR  %s, %d, " format, __FILE__, __LINE__, ##__VA_ARGS__)
-
-#ifndef ASSERT
-#define ASSERT(expr) do {                                                                                               \
-        if (!(expr))                                                                                                    \
-            ERROR();                                                                                                    \
-        assert(expr);                                                                                                   \
-    } while(0)
-#endif
-
 #endif // __VIDEO_GL_RENDER_H__